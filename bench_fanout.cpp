@@ -0,0 +1,204 @@
+// Fan-out benchmark：N 個 client 同時下載同一個檔案，比較 server 送出的
+// 封包數、bytes 與全部下載完成所需的時間
+//   ./bench_fanout [接收者數] [server 參數...]
+// 每種方式都重新啟動 ./server 各跑一次：
+//   unicast    每個 client 各自 download()（FILE_REQ，逐封包 ACK）
+//   fan-out    downloadFanout()，server 以同一份排程逐一送給每個接收者
+//   multicast  downloadFanout()，server 以 IP multicast 送到 loopback 上的群組
+// server 送出的量取自傳輸結束時 server 印出的「📊 送出排程」統計。
+#include <arpa/inet.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.hpp"
+#include "client_connection.hpp"
+#include "event_loop.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+struct Receiver {
+    bool ok = false;
+    size_t lines = 0;
+    size_t hash = 0;
+    Clock::time_point done_at;
+};
+
+struct ServerStats {
+    unsigned long long priority = 0;
+    unsigned long long bulk = 0;
+    unsigned long long bytes = 0;
+};
+
+struct PhaseResult {
+    size_t ok = 0;
+    double total_ms = 0;
+    double mean_ms = 0;
+    ServerStats stats;
+};
+
+size_t hashLine(size_t hash, std::string_view line)
+{
+    return hash * 31 + std::hash<std::string_view>{}(line);
+}
+
+// 依檔案內容算出每個接收者應該得到的 hash
+size_t expectedHash(size_t &lines)
+{
+    std::ifstream in(std::filesystem::path("files") / kBulkFile);
+    std::string line;
+    size_t hash = 0;
+    for (lines = 0; std::getline(in, line); ++lines)
+        hash = hashLine(hash, line);
+    return hash;
+}
+
+// 持續讀取 server 的輸出（不讀會讓 server 卡在寫 stdout），保留最後一筆統計
+void collectStats(int fd, ServerStats &stats, std::mutex &mu)
+{
+    FILE *in = fdopen(fd, "r");
+    char line[4096];
+    while (std::fgets(line, sizeof(line), in)) {
+        const char *p = std::strstr(line, "送出排程：priority=");
+        if (!p)
+            continue;
+        ServerStats s;
+        if (std::sscanf(std::strchr(p, '=') + 1, "%llu bulk=%llu bytes=%llu",
+                        &s.priority, &s.bulk, &s.bytes) == 3) {
+            std::lock_guard<std::mutex> lock(mu);
+            stats = s;
+        }
+    }
+    std::fclose(in);
+}
+
+Task<void> receive(ClientConnection &conn, bool fanout, Receiver &r)
+{
+    auto sink = [&r](std::string_view line) {
+        r.hash = hashLine(r.hash, line);
+        ++r.lines;
+    };
+    r.ok = fanout ? co_await conn.downloadFanout(kBulkFile, sink)
+                  : co_await conn.download(kBulkFile, sink);
+    r.done_at = Clock::now();
+}
+
+Task<bool> sleepFor(EventLoop &loop, int ms)
+{
+    co_await loop.sleep(ms);
+    co_return true;
+}
+
+PhaseResult runPhase(size_t receivers,
+                     bool fanout,
+                     const std::vector<std::string> &server_args,
+                     size_t lines,
+                     size_t hash)
+{
+    sockaddr_in server{};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(9000);
+    server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    PhaseResult result;
+    waitForPort(server);
+    int out_fd = -1;
+    pid_t server_pid = startServer(server_args, &out_fd);
+    if (server_pid < 0)
+        return result;
+    std::mutex mu;
+    std::thread reader(collectStats, out_fd, std::ref(result.stats),
+                       std::ref(mu));
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    EventLoop loop;
+    std::vector<std::unique_ptr<ClientConnection>> conns;
+    std::vector<Receiver> states(receivers);
+    bool connected = true;
+    for (size_t i = 0; connected && i < receivers; ++i) {
+        conns.push_back(std::make_unique<ClientConnection>(loop, server));
+        connected = loop.runUntilComplete(conns.back()->connect());
+    }
+
+    if (connected) {
+        auto start = Clock::now();
+        for (size_t i = 0; i < receivers; ++i)
+            loop.spawn(receive(*conns[i], fanout, states[i]));
+        loop.run();
+
+        double sum_ms = 0;
+        for (const Receiver &r : states) {
+            double ms = std::chrono::duration<double, std::milli>(r.done_at -
+                                                                  start)
+                            .count();
+            sum_ms += ms;
+            result.total_ms = std::max(result.total_ms, ms);
+            if (r.ok && r.lines == lines && r.hash == hash)
+                ++result.ok;
+        }
+        result.mean_ms = sum_ms / receivers;
+        // 等 server 收到最後的 ACK / NAK、結束傳輸並印出統計
+        loop.runUntilComplete(sleepFor(loop, 500));
+    } else {
+        std::fprintf(stderr, "❌ 無法連上 server\n");
+    }
+
+    kill(server_pid, SIGTERM);
+    waitpid(server_pid, nullptr, 0);
+    reader.join();
+    return result;
+}
+
+void report(const char *label, size_t receivers, const PhaseResult &r,
+            uintmax_t file_bytes)
+{
+    std::printf("%-10s %5zu/%-5zu %10.0f %10.0f %10llu %12llu %8.2f\n", label,
+                r.ok, receivers, r.total_ms, r.mean_ms,
+                r.stats.priority + r.stats.bulk, r.stats.bytes,
+                file_bytes ? double(r.stats.bytes) / file_bytes : 0.0);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t receivers = argc > 1 ? std::max<size_t>(std::stoul(argv[1]), 1) : 32;
+    std::vector<std::string> server_args(argv + std::min(argc, 2),
+                                         argv + argc);
+
+    ensureBulkFile();
+    size_t lines = 0;
+    size_t hash = expectedHash(lines);
+    uintmax_t file_bytes =
+        std::filesystem::file_size(std::filesystem::path("files") / kBulkFile);
+
+    std::vector<std::string> multicast_args = server_args;
+    multicast_args.push_back("--fanout-group=239.255.0.1:9100");
+    multicast_args.push_back("--fanout-if=127.0.0.1");
+
+    std::printf("%zu 個接收者同時下載 %s（%ju bytes，%zu 行）\n", receivers,
+                kBulkFile, file_bytes, lines);
+    std::printf("%-10s %11s %10s %10s %10s %12s %8s\n", "", "ok",
+                "total(ms)", "mean(ms)", "packets", "bytes", "x file");
+    report("unicast", receivers,
+           runPhase(receivers, false, server_args, lines, hash), file_bytes);
+    report("fan-out", receivers,
+           runPhase(receivers, true, server_args, lines, hash), file_bytes);
+    report("multicast", receivers,
+           runPhase(receivers, true, multicast_args, lines, hash), file_bytes);
+    return 0;
+}
@@ -0,0 +1,132 @@
+// I/O 後端效能比較：在 loopback 上量測每秒封包數與每個封包花費的 CPU 時間
+//   ./bench_io [封包數]
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "io_backend.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+double threadCpuSeconds()
+{
+    rusage ru;
+    getrusage(RUSAGE_THREAD, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+           ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+int makeSocket(sockaddr_in &addr)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int buf = 8 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+    addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    bind(sock, (sockaddr *) &addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(sock, (sockaddr *) &addr, &len);
+    return sock;
+}
+
+void report(const char *backend, const char *dir, size_t pkts, double secs,
+            double cpu)
+{
+    std::printf("%-9s %-4s %10zu pkts %12.0f pps %9.0f ns/pkt CPU\n", backend,
+                dir, pkts, pkts / secs, pkts ? cpu * 1e9 / pkts : 0.0);
+}
+
+void benchReceive(const std::string &name, size_t count)
+{
+    sockaddr_in server_addr;
+    int sock = makeSocket(server_addr);
+    auto io = makeIoBackend(sock, name);
+    const std::string backend = io->name();
+
+    std::atomic<bool> done{false};
+    std::thread blaster([&] {
+        sockaddr_in self;
+        int tx = makeSocket(self);
+        std::string payload(64, 'x');
+        for (size_t i = 0; i < count; ++i) {
+            sendto(tx, payload.data(), payload.size(), 0,
+                   (sockaddr *) &server_addr, sizeof(server_addr));
+            // 避免 loopback 接收緩衝區溢位造成大量掉包
+            if (i % 256 == 255)
+                std::this_thread::yield();
+        }
+        close(tx);
+        done = true;
+    });
+
+    size_t received = 0;
+    Datagram d;
+    double cpu0 = threadCpuSeconds();
+    auto t0 = Clock::now();
+    while (received < count) {
+        if (!io->receive(d, 200)) {
+            if (done)
+                break;
+            continue;
+        }
+        ++received;
+    }
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    double cpu = threadCpuSeconds() - cpu0;
+    blaster.join();
+
+    report(backend.c_str(), "recv", received, secs, cpu);
+    io.reset();
+    close(sock);
+}
+
+void benchSend(const std::string &name, size_t count)
+{
+    sockaddr_in self, sink_addr;
+    int sock = makeSocket(self);
+    int sink = makeSocket(sink_addr);
+    auto io = makeIoBackend(sock, name);
+    const std::string backend = io->name();
+
+    std::string payload(64, 'x');
+    double cpu0 = threadCpuSeconds();
+    auto t0 = Clock::now();
+    for (size_t i = 0; i < count; ++i) {
+        io->queueSend(sink_addr, payload);
+        if (i % 32 == 31)
+            io->flush();
+    }
+    io->flush();
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    double cpu = threadCpuSeconds() - cpu0;
+
+    report(backend.c_str(), "send", count, secs, cpu);
+    io.reset();
+    close(sink);
+    close(sock);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t count = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    for (const char *name : {"socket", "epoll", "io_uring"}) {
+        benchReceive(name, count);
+        benchSend(name, count);
+    }
+    return 0;
+}
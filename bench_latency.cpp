@@ -0,0 +1,180 @@
+// 延遲 benchmark：量測大檔案下載佔滿連結時，EXPR_REQ 的 p50 / p99 延遲
+//   ./bench_latency [bulk 連線數] [server 參數...]
+// 自行啟動 ./server，先在沒有其他流量時量一次基準，再讓 bulk 連線不斷下載
+// files/bench_bulk.txt（不存在時自動產生）的同時再量一次。
+// 以 --sched=fifo 執行可對照沒有 priority lane 與 DRR 的情況。
+#include <arpa/inet.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.hpp"
+#include "client_connection.hpp"
+#include "event_loop.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+constexpr int kSamples = 400;
+constexpr int kIntervalMs = 5;
+
+struct Result {
+    std::vector<double> latencies_ms;
+    int lost = 0;
+};
+
+struct BulkStats {
+    bool stop = false;
+    size_t lines = 0;
+    size_t downloads = 0;
+    size_t failures = 0;
+};
+
+// 依固定間隔送出 kSamples 個算式，記錄每個的來回時間
+Task<Result> measure(EventLoop &loop, ClientConnection &conn)
+{
+    Result result;
+    for (int i = 0; i < kSamples; ++i) {
+        auto start = Clock::now();
+        std::optional<std::string> res = co_await conn.evaluate("3+5*2");
+        if (res)
+            result.latencies_ms.push_back(
+                std::chrono::duration<double, std::milli>(Clock::now() - start)
+                    .count());
+        else
+            ++result.lost;
+        co_await loop.sleep(kIntervalMs);
+    }
+    co_return result;
+}
+
+Task<void> bulk(ClientConnection &conn, BulkStats &stats)
+{
+    while (!stats.stop) {
+        bool ok = co_await conn.download(
+            kBulkFile, [&stats](std::string_view) { ++stats.lines; });
+        ++(ok ? stats.downloads : stats.failures);
+    }
+}
+
+Task<bool> sleepFor(EventLoop &loop, int ms)
+{
+    co_await loop.sleep(ms);
+    co_return true;
+}
+
+double percentile(std::vector<double> v, double p)
+{
+    if (v.empty())
+        return 0;
+    std::sort(v.begin(), v.end());
+    size_t i = std::min(v.size() - 1, size_t(p / 100.0 * v.size()));
+    return v[i];
+}
+
+void report(const char *label, const Result &r)
+{
+    std::printf("%-12s %8zu %6d %9.2f %9.2f %9.2f\n", label,
+                r.latencies_ms.size(), r.lost, percentile(r.latencies_ms, 50),
+                percentile(r.latencies_ms, 99),
+                r.latencies_ms.empty() ? 0.0
+                                       : *std::max_element(
+                                             r.latencies_ms.begin(),
+                                             r.latencies_ms.end()));
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t bulk_conns = argc > 1 ? std::stoul(argv[1]) : 4;
+    std::vector<std::string> server_args(argv + std::min(argc, 2),
+                                         argv + argc);
+
+    sockaddr_in server{};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(9000);
+    server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    ensureBulkFile();
+    waitForPort(server);
+    pid_t server_pid = startServer(server_args);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    // 量測用的連線有自己的執行緒與事件迴圈，bulk 連線收封包的時間不會算進延遲
+    auto measureInThread = [&server](int delay_ms) {
+        EventLoop loop;
+        ClientConnection probe(loop, server);
+        Result result;
+        if (!loop.runUntilComplete(probe.connect())) {
+            result.lost = kSamples;
+            return result;
+        }
+        loop.runUntilComplete(sleepFor(loop, delay_ms));
+        return loop.runUntilComplete(measure(loop, probe));
+    };
+
+    EventLoop loop;
+    std::vector<std::unique_ptr<ClientConnection>> bulk_clients;
+    bool connected = true;
+    for (size_t i = 0; connected && i < bulk_conns; ++i) {
+        bulk_clients.push_back(
+            std::make_unique<ClientConnection>(loop, server));
+        connected = loop.runUntilComplete(bulk_clients.back()->connect());
+    }
+    if (!connected) {
+        std::fprintf(stderr, "❌ 無法連上 server\n");
+        kill(server_pid, SIGTERM);
+        waitpid(server_pid, nullptr, 0);
+        return 1;
+    }
+
+    std::printf("%-12s %8s %6s %9s %9s %9s\n", "", "samples", "lost",
+                "p50(ms)", "p99(ms)", "max(ms)");
+    report("idle", measureInThread(0));
+
+    BulkStats stats;
+    for (auto &conn : bulk_clients)
+        loop.spawn(bulk(*conn, stats));
+
+    // 先讓 bulk 傳輸的 cwnd 長起來再開始量測
+    std::atomic<bool> measured = false;
+    Result loaded;
+    size_t lines_before = 0;
+    Clock::time_point t0;
+    std::thread prober([&] {
+        loaded = measureInThread(500);
+        measured = true;
+    });
+    loop.runUntilComplete(sleepFor(loop, 500));
+    lines_before = stats.lines;
+    t0 = Clock::now();
+    while (!measured)
+        loop.runUntilComplete(sleepFor(loop, 10));
+    prober.join();
+    double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+    size_t bulk_lines = stats.lines - lines_before;
+    report("bulk load", loaded);
+
+    std::printf("bulk：%zu 條連線，%.0f 行/s（完成 %zu 次下載，失敗 %zu 次）\n",
+                bulk_conns, bulk_lines / secs, stats.downloads,
+                stats.failures);
+
+    // 等進行中的下載結束再關閉 server
+    stats.stop = true;
+    loop.run();
+
+    kill(server_pid, SIGTERM);
+    waitpid(server_pid, nullptr, 0);
+    return 0;
+}
@@ -0,0 +1,187 @@
+// Soak 測試：大量短命 client 進出 server，定期取樣 server 的 RSS
+//   ./bench_soak [client 數] [server 參數...]
+// 自行啟動 ./server（未指定參數時為 --idle-timeout=2），每個 client 從不同的
+// 127.x.y.z 位址完成握手、送出一個 EXPR_REQ 後就消失，不會再送任何封包。
+// 閒置連線被淘汰時 RSS 應維持平坦；以 --idle-timeout=0 執行可對照不淘汰的情況。
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.hpp"
+#include "packet.hpp"
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t kBatch = 128;
+constexpr int kReplyTimeoutMs = 500;
+
+struct SoakClient {
+    int sock = -1;
+    uint32_t cookie = 0;
+    bool replied = false;
+};
+
+long rssKb(pid_t pid)
+{
+    std::ifstream status("/proc/" + std::to_string(pid) + "/status");
+    std::string line;
+    while (std::getline(status, line))
+        if (line.rfind("VmRSS:", 0) == 0)
+            return std::stol(line.substr(6));
+    return -1;
+}
+
+// 第 i 個 client 使用 127.0.0.0/8 中的第 i + 2 個位址（略過 127.0.0.1）
+int makeClientSocket(size_t i, const sockaddr_in &server)
+{
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(0x7f000000 | (i % 0xfffffd + 2));
+    int sock = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    bind(sock, (sockaddr *) &addr, sizeof(addr));
+    connect(sock, (const sockaddr *) &server, sizeof(server));
+    return sock;
+}
+
+void sendPacket(int sock, const Packet &pkt)
+{
+    std::string raw = pkt.serialize();
+    send(sock, raw.data(), raw.size(), 0);
+}
+
+// 等待每個尚未回應的 client 收到 expect 類型的封包，逾時就放棄
+void collectReplies(std::vector<SoakClient> &batch, PacketType expect)
+{
+    auto deadline = Clock::now() + std::chrono::milliseconds(kReplyTimeoutMs);
+    while (Clock::now() < deadline) {
+        std::vector<pollfd> fds;
+        std::vector<SoakClient *> owners;
+        for (SoakClient &c : batch) {
+            if (!c.replied) {
+                fds.push_back({c.sock, POLLIN, 0});
+                owners.push_back(&c);
+            }
+        }
+        if (fds.empty())
+            return;
+
+        int left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                       deadline - Clock::now())
+                       .count();
+        if (poll(fds.data(), fds.size(), std::max(left, 0)) <= 0)
+            return;
+
+        char buf[2048];
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if (!(fds[i].revents & POLLIN))
+                continue;
+            ssize_t n = recv(fds[i].fd, buf, sizeof(buf), 0);
+            if (n <= 0)
+                continue;
+            try {
+                Packet pkt = Packet::deserialize(std::string(buf, n));
+                if (pkt.type != expect)
+                    continue;
+                owners[i]->cookie = pkt.seq;
+                owners[i]->replied = true;
+            } catch (const std::exception &) {
+            }
+        }
+    }
+}
+
+// 一批 client：SYN → SYN_ACK → ACK + EXPR_REQ → EXPR_RES，然後直接關閉
+size_t runBatch(size_t first, size_t count, const sockaddr_in &server)
+{
+    std::vector<SoakClient> batch(count);
+    for (size_t i = 0; i < count; ++i) {
+        batch[i].sock = makeClientSocket(first + i, server);
+        sendPacket(batch[i].sock, {1, 0, 1024, PacketType::SYN, "client"});
+    }
+    collectReplies(batch, PacketType::SYN_ACK);
+
+    for (SoakClient &c : batch) {
+        if (!c.replied)
+            continue;
+        c.replied = false;
+        sendPacket(c.sock, {2, c.cookie + 1, 1024, PacketType::ACK, ""});
+        sendPacket(c.sock,
+                   {2, c.cookie + 1, 1024, PacketType::EXPR_REQ, "1+2"});
+    }
+    collectReplies(batch, PacketType::EXPR_RES);
+
+    size_t ok = 0;
+    for (SoakClient &c : batch) {
+        ok += c.replied;
+        close(c.sock);
+    }
+    return ok;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    size_t total = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    std::vector<std::string> server_args(argv + std::min(argc, 2),
+                                         argv + argc);
+    if (server_args.empty())
+        server_args = {"--idle-timeout=2"};
+
+    pid_t server_pid = startServer(server_args);
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    sockaddr_in server{};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(9000);
+    server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    std::printf("%12s %10s %10s %10s %12s\n", "clients", "ok", "sec",
+                "clients/s", "server RSS");
+    auto t0 = Clock::now();
+    size_t done = 0, ok = 0;
+    size_t report_every = std::max<size_t>(total / 20, kBatch);
+    size_t next_report = report_every;
+    long first_rss = rssKb(server_pid);
+
+    auto report = [&](size_t clients) {
+        double secs =
+            std::chrono::duration<double>(Clock::now() - t0).count();
+        std::printf("%12zu %10zu %10.1f %10.0f %9.1f MB\n", clients, ok, secs,
+                    secs > 0 ? clients / secs : 0.0,
+                    rssKb(server_pid) / 1024.0);
+        std::fflush(stdout);
+    };
+
+    while (done < total) {
+        size_t count = std::min(kBatch, total - done);
+        ok += runBatch(done, count, server);
+        done += count;
+        if (done >= next_report) {
+            report(done);
+            next_report += report_every;
+        }
+    }
+
+    // 等最後一批 client 也超過閒置逾時，確認連線都被回收
+    std::this_thread::sleep_for(std::chrono::seconds(4));
+    report(done);
+    std::printf("起始 RSS %.1f MB\n", first_rss / 1024.0);
+
+    kill(server_pid, SIGTERM);
+    waitpid(server_pid, nullptr, 0);
+    return ok == total ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+#include "bench_util.hpp"
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <fstream>
+#include <thread>
+
+std::filesystem::path ensureBulkFile()
+{
+    std::filesystem::path path = std::filesystem::path("files") / kBulkFile;
+    if (std::filesystem::exists(path))
+        return path;
+    std::filesystem::create_directories("files");
+    std::ofstream out(path);
+    for (size_t i = 0; i < kBulkLines; ++i)
+        out << "line " << i
+            << " ------------------------------------------------------\n";
+    return path;
+}
+
+void waitForPort(const sockaddr_in &server)
+{
+    for (int i = 0; i < 50; ++i) {
+        int sock = socket(AF_INET, SOCK_DGRAM, 0);
+        bool free = bind(sock, (const sockaddr *) &server, sizeof(server)) == 0;
+        close(sock);
+        if (free)
+            return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+}
+
+pid_t startServer(const std::vector<std::string> &args, int *out_fd)
+{
+    int fds[2] = {-1, -1};
+    if (out_fd && pipe(fds) < 0)
+        return -1;
+    pid_t pid = fork();
+    if (pid != 0) {
+        if (out_fd) {
+            close(fds[1]);
+            *out_fd = fds[0];
+        }
+        return pid;
+    }
+
+    int out = out_fd ? fds[1] : open("/dev/null", O_WRONLY);
+    dup2(out, STDOUT_FILENO);
+    dup2(out, STDERR_FILENO);
+    close(out);
+    if (out_fd)
+        close(fds[0]);
+    std::vector<char *> argv{const_cast<char *>("./server")};
+    for (const std::string &a : args)
+        argv.push_back(const_cast<char *>(a.c_str()));
+    argv.push_back(nullptr);
+    execv("./server", argv.data());
+    _exit(127);
+}
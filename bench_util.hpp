@@ -0,0 +1,25 @@
+#pragma once
+#include <netinet/in.h>
+#include <sys/types.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// benchmark 共用的輔助函式：啟動 ./server、等待 port 釋放、產生測試檔
+
+// bulk 下載使用的測試檔（位於 files/ 下）與其行數
+inline constexpr const char *kBulkFile = "bench_bulk.txt";
+inline constexpr size_t kBulkLines = 20000;
+
+// files/ 下的 kBulkFile 不存在時產生 kBulkLines 行的內容，回傳其路徑
+std::filesystem::path ensureBulkFile();
+
+// 前一個 server（尤其是 io_uring 後端）結束後，port 可能還要一下子才會釋放
+void waitForPort(const sockaddr_in &server);
+
+// 以 args 啟動 ./server。out_fd 為 nullptr 時丟棄 server 的輸出，
+// 否則 stdout / stderr 接到 pipe，讀取端存入 *out_fd；失敗時回傳 -1
+pid_t startServer(const std::vector<std::string> &args,
+                  int *out_fd = nullptr);
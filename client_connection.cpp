@@ -0,0 +1,508 @@
+#include "client_connection.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+
+ClientConnection::ClientConnection(EventLoop &loop, const sockaddr_in &server)
+    : loop_(loop), sock_(socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0))
+{
+    // connect() 讓 kernel 只把 server 的封包交給這個 socket
+    ::connect(sock_, (const sockaddr *) &server, sizeof(server));
+    // kernel 預設的接收緩衝區只放得下數百個封包，遠小於通告的視窗；
+    // 放大後 server 的整個視窗湧入時才不會在 kernel 中被丟掉（上限為 rmem_max）
+    int rcvbuf = 4 << 20;
+    setsockopt(sock_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    loop_.watch(sock_, [this] { onReadable(sock_); });
+    setReceiveBuffer(kDefaultReceiveBuffer);
+}
+
+ClientConnection::~ClientConnection()
+{
+    loop_.unwatch(sock_);
+    close(sock_);
+}
+
+void ClientConnection::send(const Packet &pkt)
+{
+    std::string raw = pkt.serialize();
+    ::send(sock_, raw.data(), raw.size(), 0);
+}
+
+void ClientConnection::setReceiveBuffer(uint32_t packets)
+{
+    receive_buffer_ = std::max<uint32_t>(packets, 1);
+    // 取最小的 scale，使整個 buffer 可以放進 16-bit 的 window 欄位
+    wscale_ = 0;
+    while ((receive_buffer_ >> wscale_) > 0xffff && wscale_ < kMaxWindowScale)
+        ++wscale_;
+}
+
+uint16_t ClientConnection::advertisedWindow() const
+{
+    uint32_t free = receive_buffer_ - buffered_;
+    return std::min<uint32_t>(free >> peer_scale_, 0xffff);
+}
+
+void ClientConnection::sendDataAck(const Packet &pkt)
+{
+    // 加入 padding，避免 ACK 被丟棄；每個 ACK 都帶回目前的可用空間。
+    // ack 欄位帶回資料封包上的請求 seq：同一條連線同時有多個下載時，
+    // 各傳輸的 seq 範圍會重疊，server 以此分辨 ACK 屬於哪一個傳輸
+    send({pkt.seq + 1, pkt.ack, advertisedWindow(), PacketType::DATA_ACK,
+          std::string(16, 'A')});
+}
+
+bool ClientConnection::receiveChunk(PendingDownload &d, const Packet &pkt)
+{
+    d.responded = true;
+    d.activity.set();
+
+    uint32_t idx = pkt.seq - d.base;
+    // 重複的資料照樣 ACK（也是 zero window probe 的回應）
+    if (idx < d.next || d.reorder.contains(idx))
+        return true;
+
+    if (idx != d.next) {
+        if (idx - d.next >= receive_buffer_ || buffered_ >= receive_buffer_)
+            return false;
+        d.reorder.emplace(idx, pkt.payload);
+        ++buffered_;
+        return true;
+    }
+
+    // 補上缺口：連同 reorder buffer 中接續的部分一起交付
+    d.sink(pkt.payload);
+    ++d.next;
+    for (auto it = d.reorder.find(d.next); it != d.reorder.end();
+         it = d.reorder.find(d.next)) {
+        d.sink(it->second);
+        d.reorder.erase(it);
+        --buffered_;
+        ++d.next;
+    }
+    if (d.end_seen && d.next == d.end)
+        d.finished = true;
+    return true;
+}
+
+void ClientConnection::sendNak(uint32_t session,
+                               uint32_t round,
+                               const PendingDownload *d)
+{
+    // reorder buffer 中沒有的 chunk 即為缺漏；依序合併成範圍
+    std::vector<ChunkRange> missing;
+    uint32_t idx = d ? d->next : 0;
+    while (d && idx < d->end && missing.size() < kMaxNakRanges) {
+        if (d->reorder.contains(idx)) {
+            ++idx;
+            continue;
+        }
+        uint32_t first = idx;
+        while (idx < d->end && !d->reorder.contains(idx))
+            ++idx;
+        missing.emplace_back(first, idx - 1);
+    }
+    std::string payload = formatRanges(missing);
+    if (!d && std::find(finished_fanouts_.begin(), finished_fanouts_.end(),
+                        session) == finished_fanouts_.end())
+        payload = kNakUnknownSession;
+    send({round, session, advertisedWindow(), PacketType::FANOUT_NAK,
+          payload});
+}
+
+int ClientConnection::joinGroup(const std::string &group)
+{
+    size_t colon = group.rfind(':');
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    if (colon == std::string::npos ||
+        inet_pton(AF_INET, group.substr(0, colon).c_str(), &addr.sin_addr) !=
+            1)
+        return -1;
+    addr.sin_port = htons(std::atoi(group.c_str() + colon + 1));
+
+    // 在通往 server 的介面（connect() 後 sock_ 的本地位址）上加入群組
+    sockaddr_in local{};
+    socklen_t len = sizeof(local);
+    getsockname(sock_, (sockaddr *) &local, &len);
+    ip_mreq mreq{addr.sin_addr, local.sin_addr};
+
+    // 同一台主機上的每個接收者都綁定群組的 port，各自收到一份
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    int rcvbuf = 4 << 20;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    if (bind(fd, (const sockaddr *) &addr, sizeof(addr)) < 0 ||
+        setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) <
+            0) {
+        close(fd);
+        return -1;
+    }
+    loop_.watch(fd, [this, fd] { onReadable(fd); });
+    return fd;
+}
+
+void ClientConnection::onReadable(int fd)
+{
+    char buffer[4096];
+    while (true) {
+        ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+        if (n <= 0)
+            return;
+        try {
+            dispatch(Packet::deserialize(std::string(buffer, n)));
+        } catch (const std::exception &) {
+            std::cerr << "⚠️ 收到無法解析的封包，已忽略\n";
+        }
+    }
+}
+
+void ClientConnection::dispatch(const Packet &pkt)
+{
+    switch (pkt.type) {
+    case PacketType::SYN_ACK:
+        if (handshake_) {
+            syn_ack_ = pkt;
+            handshake_->set();
+        }
+        break;
+
+    // server 的 keepalive probe：以 ACK 回應，讓連線不被當成閒置而移除
+    case PacketType::ACK:
+        if (server_ack_ != 0)
+            send({next_seq_, server_ack_, advertisedWindow(), PacketType::ACK,
+                  ""});
+        break;
+
+    // server 已不認得這條連線：清掉 cookie，還沒有回應的請求重送前會重新握手
+    case PacketType::RST:
+        if (server_ack_ == 0)
+            break;
+        std::cerr << "⚠️ 連線已被 server 重置，重新握手\n";
+        server_ack_ = 0;
+        for (auto *pending : {&downloads_, &fanout_requests_})
+            for (auto &[seq, d] : *pending)
+                if (!d->responded)
+                    d->activity.set();
+        break;
+
+    case PacketType::EXPR_RES: {
+        auto it = exprs_.find(pkt.ack);
+        if (it != exprs_.end()) {
+            it->second->result = pkt.payload;
+            it->second->done.set();
+        }
+        break;
+    }
+
+    case PacketType::FILE_DATA: {
+        // 已結束的下載也要 ACK，server 才不會卡在重傳
+        auto it = downloads_.find(pkt.ack);
+        if (it == downloads_.end() || receiveChunk(*it->second, pkt))
+            sendDataAck(pkt);
+        break;
+    }
+
+    case PacketType::FILE_END: {
+        for (int i = 0; i < 3; ++i)
+            sendDataAck(pkt);
+        auto it = downloads_.find(pkt.ack);
+        if (it != downloads_.end()) {
+            // server 只在所有資料都被 ACK 後才送 FILE_END，此時仍有缺口即為不完整
+            PendingDownload &d = *it->second;
+            d.end = pkt.seq - d.base;
+            d.end_seen = true;
+            d.finished = d.next == d.end;
+            d.truncated = !d.finished;
+            d.activity.set();
+        }
+        break;
+    }
+
+    // 一般下載與還在等 FANOUT_INFO 的 fan-out 下載都以請求的 seq 對應
+    case PacketType::FILE_ERR:
+        for (auto *pending : {&downloads_, &fanout_requests_}) {
+            auto it = pending->find(pkt.ack);
+            if (it != pending->end()) {
+                it->second->failed = true;
+                it->second->activity.set();
+            }
+        }
+        break;
+
+    case PacketType::FANOUT_INFO: {
+        auto it = fanout_requests_.find(pkt.ack);
+        size_t sep = pkt.payload.find('|');
+        if (it == fanout_requests_.end() || it->second->responded ||
+            sep == std::string::npos)
+            break;
+        PendingDownload &d = *it->second;
+        try {
+            d.end = std::stoul(pkt.payload.substr(0, sep));
+        } catch (const std::exception &) {
+            break;
+        }
+        d.session = pkt.seq;
+        d.group = pkt.payload.substr(sep + 1);
+        d.end_seen = true;
+        d.responded = true;
+        d.finished = d.end == 0;
+        fanouts_[d.session] = &d;
+        if (d.finished)
+            sendNak(d.session, 0, &d);
+        d.activity.set();
+        break;
+    }
+
+    // fan-out 的資料不逐封包 ACK，缺漏等 FANOUT_FLUSH 時再一次回報
+    case PacketType::FANOUT_DATA: {
+        auto it = fanouts_.find(pkt.ack);
+        if (it == fanouts_.end() || pkt.seq >= it->second->end)
+            break;
+        PendingDownload &d = *it->second;
+        bool was_finished = d.finished;
+        receiveChunk(d, pkt);
+        // 收齊時主動回報，server 不必等到下一次 FLUSH
+        if (d.finished && !was_finished)
+            sendNak(d.session, 0, &d);
+        break;
+    }
+
+    case PacketType::FANOUT_FLUSH: {
+        auto it = fanouts_.find(pkt.ack);
+        PendingDownload *d = it == fanouts_.end() ? nullptr : it->second;
+        sendNak(pkt.ack, pkt.seq, d);
+        if (d)
+            d->activity.set();
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+Task<bool> ClientConnection::connect()
+{
+    Event ev(loop_);
+    handshake_ = &ev;
+    uint32_t isn = next_seq_++;
+    // SYN 上的視窗不縮放，並附上 window scale 選項
+    uint16_t syn_window = std::min<uint32_t>(receive_buffer_, 0xffff);
+    for (int i = 0; i < kMaxRetries && !ev.isSet(); ++i) {
+        send({isn, 0, syn_window, PacketType::SYN,
+              withWindowScale(wscale_, "client")});
+        co_await ev.wait(kRetryMs);
+    }
+    handshake_ = nullptr;
+    if (!ev.isSet())
+        co_return false;
+    completeHandshake();
+    co_return true;
+}
+
+void ClientConnection::completeHandshake()
+{
+    // server 回帶選項才啟用 scale，否則通告值最多 65535
+    std::string payload = syn_ack_.payload;
+    uint8_t server_scale = 0;
+    peer_scale_ = stripWindowScale(payload, server_scale) ? wscale_ : 0;
+
+    // ACK 的 ack 欄位帶回 SYN cookie + 1，之後每個請求也都帶著它
+    server_ack_ = syn_ack_.seq + 1;
+    send({next_seq_, server_ack_, advertisedWindow(), PacketType::ACK, ""});
+
+    size_t pos = payload.find(':');
+    if (pos != std::string::npos && pos + 1 < payload.size())
+        client_id_ = payload.substr(pos + 1);
+}
+
+Task<void> ClientConnection::refresh(Packet &req)
+{
+    if (req.type == PacketType::SYN)
+        co_return;
+    if (server_ack_ == 0 && !handshake_)
+        co_await connect();
+    if (server_ack_ != 0)
+        req.ack = server_ack_;
+}
+
+Task<std::optional<std::string>> ClientConnection::requestExpr(Packet req)
+{
+    PendingExpr pending{Event(loop_), ""};
+    exprs_[req.seq] = &pending;
+
+    // 逾時就重送（server 可能正忙著傳檔而丟掉請求），間隔指數成長
+    int timeout = kRetryMs;
+    for (int i = 0; i < kMaxRetries && !pending.done.isSet(); ++i) {
+        co_await refresh(req);
+        send(req);
+        co_await pending.done.wait(timeout);
+        timeout *= 2;
+    }
+    exprs_.erase(req.seq);
+
+    if (!pending.done.isSet())
+        co_return std::nullopt;
+    co_return pending.result;
+}
+
+Task<std::optional<std::string>> ClientConnection::evaluate(
+    const std::string &expr)
+{
+    return requestExpr({next_seq_++, server_ack_, advertisedWindow(),
+                        PacketType::EXPR_REQ, expr});
+}
+
+Task<std::optional<std::string>> ClientConnection::evaluateEarly(
+    const std::string &expr)
+{
+    // server 以 EXPR_RES.ack = SYN 的 seq 回應
+    return requestExpr({next_seq_++, 0, advertisedWindow(), PacketType::SYN,
+                        makeEarlyData(PacketType::EXPR_REQ, expr)});
+}
+
+Task<bool> ClientConnection::download(const std::string &filename, Sink sink)
+{
+    uint32_t seq = next_seq_++;
+    Packet req = {seq, server_ack_, advertisedWindow(), PacketType::FILE_REQ,
+                  filename};
+    PendingDownload d{Event(loop_), std::move(sink), seq + 1};
+    downloads_[seq] = &d;
+    send(req);
+    co_return co_await awaitDownload(seq, d, req, filename);
+}
+
+Task<bool> ClientConnection::downloadEarly(uint32_t cookie,
+                                           const std::string &filename,
+                                           Sink sink)
+{
+    // server 以 SYN 的 seq 作為請求 seq，資料從 seq + 1 開始編號
+    uint32_t seq = next_seq_++;
+    PendingDownload d{Event(loop_), std::move(sink), seq + 1};
+    downloads_[seq] = &d;
+
+    Event ev(loop_);
+    handshake_ = &ev;
+    uint16_t syn_window = std::min<uint32_t>(receive_buffer_, 0xffff);
+    Packet syn = {seq, cookie + 1, syn_window, PacketType::SYN,
+                  withWindowScale(wscale_,
+                                  makeEarlyData(PacketType::FILE_REQ,
+                                                filename))};
+    for (int i = 0; i < kMaxRetries && !ev.isSet() && !d.responded; ++i) {
+        send(syn);
+        co_await ev.wait(kRetryMs);
+    }
+    handshake_ = nullptr;
+    if (ev.isSet())
+        completeHandshake();
+
+    // SYN_ACK 比資料先送出；等一個重送間隔仍沒有資料，表示 cookie 沒被接受，
+    // 改用剛取得的 cookie 送一般的 FILE_REQ（沿用同一個 seq）
+    if (ev.isSet() && !d.responded && !d.failed) {
+        d.activity.reset();
+        co_await d.activity.wait(kRetryMs);
+    }
+    Packet req = syn;
+    if (!d.responded && !d.failed && server_ack_ != 0) {
+        req = {seq, server_ack_, advertisedWindow(), PacketType::FILE_REQ,
+               filename};
+        send(req);
+    }
+    co_return co_await awaitDownload(seq, d, req, filename);
+}
+
+Task<bool> ClientConnection::awaitDownload(uint32_t seq,
+                                           PendingDownload &d,
+                                           Packet req,
+                                           std::string filename)
+{
+    int idle = 0;
+    while (!d.finished && !d.failed && !d.truncated && idle < kMaxRetries) {
+        d.activity.reset();
+        // 被 RST 喚醒時不算有進展，立即重新握手並重送
+        bool active = co_await d.activity.wait(kIdleMs);
+        if (active && (d.responded || server_ack_ != 0)) {
+            idle = 0;
+            continue;
+        }
+        ++idle;
+        // 還沒收到任何回應時重送 FILE_REQ
+        if (!d.responded) {
+            co_await refresh(req);
+            send(req);
+        }
+    }
+    downloads_.erase(seq);
+    buffered_ -= d.reorder.size();
+
+    if (!d.finished) {
+        std::cerr << (d.failed      ? "❌ Server 找不到檔案："
+                      : d.truncated ? "❌ 資料不完整："
+                                    : "❌ 下載逾時：")
+                  << filename << "\n";
+        co_return false;
+    }
+    co_return true;
+}
+
+Task<bool> ClientConnection::downloadFanout(const std::string &filename,
+                                            Sink sink)
+{
+    uint32_t seq = next_seq_++;
+    Packet req = {seq, server_ack_, advertisedWindow(), PacketType::FANOUT_REQ,
+                  filename};
+    PendingDownload d{Event(loop_), std::move(sink)};
+    fanout_requests_[seq] = &d;
+
+    // 等待 FANOUT_INFO，請求或回覆遺失時重送
+    for (int i = 0; i < kMaxRetries && !d.responded && !d.failed; ++i) {
+        co_await refresh(req);
+        send(req);
+        d.activity.reset();
+        co_await d.activity.wait(kRetryMs);
+    }
+    fanout_requests_.erase(seq);
+
+    int group_sock = -1;
+    if (d.responded && !d.group.empty()) {
+        group_sock = joinGroup(d.group);
+        if (group_sock < 0)
+            std::cerr << "❌ 無法加入 multicast 群組 " << d.group << "\n";
+    }
+
+    // server 每一輪都會送 FLUSH，連續 kMaxRetries 次 kIdleMs 沒有動靜才放棄
+    int idle = 0;
+    while (d.responded && (d.group.empty() || group_sock >= 0) &&
+           !d.finished && idle < kMaxRetries) {
+        d.activity.reset();
+        if (co_await d.activity.wait(kIdleMs))
+            idle = 0;
+        else
+            ++idle;
+    }
+    if (group_sock >= 0) {
+        loop_.unwatch(group_sock);
+        close(group_sock);
+    }
+    fanouts_.erase(d.session);
+    buffered_ -= d.reorder.size();
+    if (d.finished && d.responded) {
+        finished_fanouts_.push_back(d.session);
+        if (finished_fanouts_.size() > kMaxFinishedFanouts)
+            finished_fanouts_.pop_front();
+    }
+
+    if (!d.finished) {
+        std::cerr << (d.failed ? "❌ Server 找不到檔案：" : "❌ 下載逾時：")
+                  << filename << "\n";
+        co_return false;
+    }
+    co_return true;
+}
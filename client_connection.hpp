@@ -0,0 +1,156 @@
+#pragma once
+#include <netinet/in.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "event_loop.hpp"
+#include "packet.hpp"
+
+// 可嵌入的 client 連線：每條連線一個 UDP socket，掛在共用的 EventLoop 上。
+// 同一條連線可以同時有多個 evaluate() / download() 在進行，
+// 回應以 ack 欄位（= 請求的 seq）對應回各自的請求。
+//
+//   EventLoop loop;
+//   ClientConnection conn(loop, server_addr);
+//   if (co_await conn.connect())
+//       auto result = co_await conn.evaluate("3+5*2");
+class ClientConnection
+{
+public:
+    using Sink = std::function<void(std::string_view line)>;
+
+    ClientConnection(EventLoop &loop, const sockaddr_in &server);
+    ~ClientConnection();
+    ClientConnection(const ClientConnection &) = delete;
+    ClientConnection &operator=(const ClientConnection &) = delete;
+
+    // 接收端 reorder buffer 的容量（封包數，預設 kDefaultReceiveBuffer）；
+    // 需在 connect() 之前設定，超過 64K 時以 window scale 通告
+    void setReceiveBuffer(uint32_t packets);
+
+    // 三次握手；失敗（多次逾時）回傳 false
+    Task<bool> connect();
+
+    // 算式請求；逾時回傳 std::nullopt
+    Task<std::optional<std::string>> evaluate(const std::string &expr);
+
+    // 0-RTT：不需要 connect()，算式直接附在 SYN 上
+    Task<std::optional<std::string>> evaluateEarly(const std::string &expr);
+
+    // 下載檔案，資料依序到齊時立即逐行交給 sink；
+    // 找不到檔案、逾時或資料不完整回傳 false（此時 sink 可能已收到部分內容）
+    Task<bool> download(const std::string &filename, Sink sink);
+
+    // 0-RTT 下載：FILE_REQ 附在 SYN 上，ack 帶著先前連線取得的 cookie
+    // （cookie() 的回傳值；cookie 只綁定 client 的 IP，新的 port 也能沿用）。
+    // SYN 同時完成握手；cookie 已過期時 server 只回 SYN_ACK，
+    // 此時改以一般的 FILE_REQ 請求，結果與 download() 相同
+    Task<bool> downloadEarly(uint32_t cookie,
+                             const std::string &filename,
+                             Sink sink);
+
+    // Fan-out 下載：server 把收集期間內請求同一個檔案的 client 合併成一次傳送，
+    // 不逐封包 ACK，只在被詢問時回報缺少的範圍（NAK）；
+    // server 啟用 multicast 時另開一個 socket 加入群組接收資料
+    Task<bool> downloadFanout(const std::string &filename, Sink sink);
+
+    // server 在 SYN_ACK 中回傳的 client 識別（其 UDP port）
+    const std::string &clientId() const { return client_id_; }
+
+    // 這條連線握手取得的 SYN cookie，供之後的 downloadEarly() 使用；
+    // 尚未握手時回傳 std::nullopt
+    std::optional<uint32_t> cookie() const
+    {
+        if (server_ack_ == 0)
+            return std::nullopt;
+        return server_ack_ - 1;
+    }
+
+private:
+    struct PendingExpr {
+        Event done;
+        std::string result;
+    };
+
+    // FILE_DATA 的 seq 從請求的 seq + 1 開始連續編號，
+    // 以 seq - base 得到 chunk 索引；亂序到達的 chunk 暫存在 reorder buffer
+    struct PendingDownload {
+        Event activity;
+        Sink sink;
+        uint32_t base = 0;
+        uint32_t next = 0;
+        uint32_t end = 0;
+        bool end_seen = false;
+        bool responded = false;
+        bool finished = false;
+        bool failed = false;
+        bool truncated = false;
+        std::unordered_map<uint32_t, std::string> reorder;
+        // fan-out：FANOUT_INFO 指定的 session 與 multicast 群組（可能為空）
+        uint32_t session = 0;
+        std::string group;
+    };
+
+    void send(const Packet &pkt);
+    // ACK 一個 FILE_DATA / FILE_END
+    void sendDataAck(const Packet &pkt);
+    // reorder buffer 剩餘空間，依協商好的 window scale 縮放
+    uint16_t advertisedWindow() const;
+    // 收下一個 FILE_DATA；reorder buffer 沒有空間而丟棄時回傳 false（不 ACK）
+    bool receiveChunk(PendingDownload &d, const Packet &pkt);
+    // 回報 d 缺少的範圍；d 為 nullptr 時，最近收齊的 session 回報收齊，
+    // 其他（不認得的）session 回報 kNakUnknownSession
+    void sendNak(uint32_t session, uint32_t round, const PendingDownload *d);
+    // 加入 multicast 群組，回傳掛在事件迴圈上的 socket；失敗回傳 -1
+    int joinGroup(const std::string &group);
+    // 依 syn_ack_ 完成握手：啟用 window scale、記下 cookie 並回 ACK
+    void completeHandshake();
+    // 連線被 server 重置（RST）後重新握手，並讓 req 改帶新的 cookie；
+    // 其他請求正在握手時不重複進行。SYN（0-RTT）請求不受影響
+    Task<void> refresh(Packet &req);
+    // 等待下載結束；沒有任何回應時重送 req
+    Task<bool> awaitDownload(uint32_t seq,
+                             PendingDownload &d,
+                             Packet req,
+                             std::string filename);
+    void onReadable(int fd);
+    void dispatch(const Packet &pkt);
+    Task<std::optional<std::string>> requestExpr(Packet req);
+
+    static constexpr int kMaxRetries = 5;
+    static constexpr int kRetryMs = 1000;
+    static constexpr int kIdleMs = 5000;
+    static constexpr uint32_t kDefaultReceiveBuffer = 1 << 18;
+    // 一個 NAK 最多列出的範圍數，其餘留到下一輪再回報
+    static constexpr size_t kMaxNakRanges = 64;
+    // 記住的已收齊 fan-out session 數
+    static constexpr size_t kMaxFinishedFanouts = 64;
+
+    EventLoop &loop_;
+    int sock_;
+    uint32_t next_seq_ = 100;
+    uint32_t server_ack_ = 0;
+    std::string client_id_ = "unknown";
+
+    uint32_t receive_buffer_ = 0;
+    uint32_t buffered_ = 0;
+    uint8_t wscale_ = 0;
+    // server 同意 window scale 後，通告的視窗以此位移
+    uint8_t peer_scale_ = 0;
+
+    Event *handshake_ = nullptr;
+    Packet syn_ack_{};
+    std::unordered_map<uint32_t, PendingExpr *> exprs_;
+    std::unordered_map<uint32_t, PendingDownload *> downloads_;
+    // fan-out 在收到 FANOUT_INFO 前以請求的 seq 索引，之後以 session id 索引
+    std::unordered_map<uint32_t, PendingDownload *> fanout_requests_;
+    std::unordered_map<uint32_t, PendingDownload *> fanouts_;
+    // 已收齊的 session：主動送出的收齊 NAK 遺失時，之後的 FLUSH 仍回報收齊
+    std::deque<uint32_t> finished_fanouts_;
+};
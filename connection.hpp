@@ -1,5 +1,6 @@
 #pragma once
 #include <chrono>
+#include <cstdint>
 #include <unordered_map>
 
 struct ConnectionState {
@@ -8,6 +9,14 @@ struct ConnectionState {
     uint16_t window_size;
     bool handshake_done;
     std::chrono::steady_clock::time_point last_active;
+    // client 最近一次通告的可用接收空間（封包數，已套用 window scale）
+    uint32_t peer_window = 0;
+    uint8_t peer_window_scale = 0;
+
+    void updatePeerWindow(uint16_t advertised)
+    {
+        peer_window = uint32_t(advertised) << peer_window_scale;
+    }
     struct CongestionState {
         size_t cwnd = 1;
         size_t ssthresh = 512;
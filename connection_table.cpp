@@ -0,0 +1,86 @@
+#include "connection_table.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+// wheel 以 1 秒為一格，一圈 256 秒；更長的期限會多繞幾圈
+constexpr std::chrono::milliseconds kTick{1000};
+constexpr size_t kSlots = 256;
+} // namespace
+
+ConnectionTable::ConnectionTable(std::chrono::seconds idle_timeout,
+                                 std::chrono::seconds keepalive)
+    : idle_timeout_(idle_timeout), keepalive_(keepalive), wheel_(kTick, kSlots)
+{
+}
+
+ConnectionState *ConnectionTable::find(const std::string &key)
+{
+    auto it = entries_.find(key);
+    return it == entries_.end() ? nullptr : &it->second.state;
+}
+
+ConnectionState &ConnectionTable::add(const std::string &key,
+                                      const sockaddr_in &addr,
+                                      const ConnectionState &state)
+{
+    Entry &entry = entries_[key];
+    entry.state = state;
+    entry.state.last_active = Clock::now();
+    entry.addr = addr;
+    entry.last_probe = entry.state.last_active;
+    scheduleCheck(key, entry);
+    return entry.state;
+}
+
+// 下一個檢查點取「該淘汰」與「該送 probe」兩者中較早的時間
+void ConnectionTable::scheduleCheck(const std::string &key, Entry &entry)
+{
+    if (idle_timeout_.count() == 0 && keepalive_.count() == 0)
+        return;
+
+    Clock::time_point when = Clock::time_point::max();
+    if (idle_timeout_.count() > 0)
+        when = entry.state.last_active + idle_timeout_;
+    if (keepalive_.count() > 0)
+        when = std::min(
+            when, std::max(entry.state.last_active, entry.last_probe) +
+                      keepalive_);
+    entry.check_tick = wheel_.schedule(key, when);
+}
+
+void ConnectionTable::expire(Clock::time_point now,
+                             const Probe &probe,
+                             const Evicted &evicted)
+{
+    wheel_.advance(now, [&](const std::string &key, uint64_t tick) {
+        auto it = entries_.find(key);
+        if (it == entries_.end() || it->second.check_tick != tick)
+            return;
+        Entry &entry = it->second;
+
+        auto idle = now - entry.state.last_active;
+        if (idle_timeout_.count() > 0 && idle >= idle_timeout_) {
+            std::cout << "🧹 移除閒置連線：" << key << "（閒置 "
+                      << std::chrono::duration_cast<std::chrono::seconds>(idle)
+                             .count()
+                      << " 秒）\n";
+            sockaddr_in addr = entry.addr;
+            entries_.erase(it);
+            ++stats_.evictions;
+            evicted(addr);
+            return;
+        }
+
+        if (keepalive_.count() > 0 &&
+            now - std::max(entry.state.last_active, entry.last_probe) >=
+                keepalive_) {
+            probe(entry.addr, entry.state);
+            entry.last_probe = now;
+            ++stats_.probes;
+        }
+        scheduleCheck(key, entry);
+    });
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include <netinet/in.h>
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "connection.hpp"
+#include "timing_wheel.hpp"
+
+// server 的連線表：以 "ip:port" 為 key，閒置過久的連線由 timing wheel 淘汰。
+//
+// 收到封包時只更新 last_active（O(1)）；每條連線在 wheel 上只有一個檢查點，
+// 到期時才比對 last_active，尚未閒置夠久就依新的期限重新排入（lazy 重新排程）。
+// 開啟 keepalive 時，閒置滿一個間隔就交給 probe callback 探測 client，
+// client 回應的任何封包都會讓連線繼續存活。
+class ConnectionTable
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using Probe =
+        std::function<void(const sockaddr_in &addr, ConnectionState &state)>;
+    using Evicted = std::function<void(const sockaddr_in &addr)>;
+
+    struct Stats {
+        uint64_t evictions = 0;
+        uint64_t probes = 0;
+    };
+
+    // idle_timeout 為 0 時不淘汰；keepalive 為 0 時不送 probe
+    ConnectionTable(std::chrono::seconds idle_timeout,
+                    std::chrono::seconds keepalive);
+
+    // 找不到時回傳 nullptr
+    ConnectionState *find(const std::string &key);
+    ConnectionState &add(const std::string &key,
+                         const sockaddr_in &addr,
+                         const ConnectionState &state);
+
+    static void touch(ConnectionState &state)
+    {
+        state.last_active = Clock::now();
+    }
+
+    // 處理 wheel 上到期的檢查點：移除閒置連線（移除後呼叫 evicted，
+    // 供其他元件釋放該連線的資源）、對需要的連線送 keepalive probe
+    void expire(Clock::time_point now,
+                const Probe &probe,
+                const Evicted &evicted);
+
+    // 事件迴圈等待的上限，確保 wheel 按時推進
+    int msUntilNextCheck(Clock::time_point now) const
+    {
+        return wheel_.msUntilNextTick(now);
+    }
+
+    size_t size() const { return entries_.size(); }
+    const Stats &stats() const { return stats_; }
+
+private:
+    struct Entry {
+        ConnectionState state;
+        sockaddr_in addr;
+        Clock::time_point last_probe;
+        // 目前有效的 wheel 檢查點；其他 tick 的項目都是過期的殘留
+        uint64_t check_tick = 0;
+    };
+
+    void scheduleCheck(const std::string &key, Entry &entry);
+
+    std::chrono::seconds idle_timeout_;
+    std::chrono::seconds keepalive_;
+    std::unordered_map<std::string, Entry> entries_;
+    TimingWheel wheel_;
+    Stats stats_;
+};
@@ -0,0 +1,95 @@
+#include "content_cache.hpp"
+
+namespace
+{
+size_t footprint(const CachedFile &f)
+{
+    return sizeof(CachedFile) + f.data.size() +
+           f.chunks.size() * sizeof(std::string_view);
+}
+} // namespace
+
+CachedFilePtr ContentCache::build(std::string data, const struct stat &st)
+{
+    auto file = std::make_shared<CachedFile>();
+    file->data = std::move(data);
+    file->mtime = st.st_mtim;
+    file->size = st.st_size;
+
+    // 與 std::getline 相同的切法：每行一個封包，最後一行可以沒有換行
+    std::string_view rest(file->data);
+    while (!rest.empty()) {
+        size_t nl = rest.find('\n');
+        if (nl == std::string_view::npos) {
+            file->chunks.push_back(rest);
+            break;
+        }
+        file->chunks.push_back(rest.substr(0, nl));
+        rest.remove_prefix(nl + 1);
+    }
+    return file;
+}
+
+void ContentCache::erase(std::list<Entry>::iterator it)
+{
+    stats_.bytes -= it->bytes;
+    index_.erase(it->path);
+    lru_.erase(it);
+    stats_.entries = lru_.size();
+}
+
+void ContentCache::get(const std::string &path, IoBackend &io, Ready ready)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) < 0 || !S_ISREG(st.st_mode)) {
+        ready(nullptr);
+        return;
+    }
+
+    auto found = index_.find(path);
+    if (found != index_.end()) {
+        const CachedFile &f = *found->second->file;
+        if (f.size == st.st_size && f.mtime.tv_sec == st.st_mtim.tv_sec &&
+            f.mtime.tv_nsec == st.st_mtim.tv_nsec) {
+            ++stats_.hits;
+            lru_.splice(lru_.begin(), lru_, found->second);
+            ready(found->second->file);
+            return;
+        }
+        // 檔案已變更：丟掉舊內容（傳輸中的 client 仍持有舊的 shared_ptr）
+        erase(found->second);
+    }
+
+    // 已經在讀取同一個檔案時只等待結果
+    auto [waiting, first] = loading_.try_emplace(path);
+    waiting->second.push_back(std::move(ready));
+    if (!first)
+        return;
+
+    ++stats_.misses;
+    io.readFile(path, [this, path, st](bool ok, std::string data) {
+        CachedFilePtr file = ok ? build(std::move(data), st) : nullptr;
+        if (file)
+            insert(path, file);
+        std::vector<Ready> waiters = std::move(loading_.at(path));
+        loading_.erase(path);
+        for (Ready &r : waiters)
+            r(file);
+    });
+}
+
+void ContentCache::insert(const std::string &path, CachedFilePtr file)
+{
+    size_t bytes = footprint(*file);
+    if (bytes > budget_)
+        return;
+
+    while (stats_.bytes + bytes > budget_ && !lru_.empty()) {
+        erase(std::prev(lru_.end()));
+        ++stats_.evictions;
+    }
+    lru_.push_front({path, std::move(file), bytes});
+    index_[path] = lru_.begin();
+    stats_.bytes += bytes;
+    stats_.entries = lru_.size();
+}
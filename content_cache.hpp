@@ -0,0 +1,64 @@
+#pragma once
+#include <sys/stat.h>
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "io_backend.hpp"
+
+// 已切好封包的檔案內容。chunks 指向 data 內部，傳輸期間持有
+// shared_ptr 即可在 cache 淘汰後繼續零拷貝送出。
+struct CachedFile {
+    std::string data;
+    std::vector<std::string_view> chunks; // 每個 FILE_DATA 的 payload（一行）
+    timespec mtime;
+    off_t size;
+};
+using CachedFilePtr = std::shared_ptr<const CachedFile>;
+
+// 以路徑為 key、mtime + size 判斷是否過期的 LRU content cache
+class ContentCache
+{
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t bytes = 0;
+        size_t entries = 0;
+    };
+
+    explicit ContentCache(size_t budget_bytes) : budget_(budget_bytes) {}
+
+    // 命中時立即以快取的內容呼叫 ready；未命中時經由 I/O 後端非同步讀檔，
+    // 讀完（io.completeReads()）才呼叫，同一個檔案同時只讀一次。
+    // 檔案不存在或讀取失敗時以 nullptr 呼叫
+    using Ready = std::function<void(CachedFilePtr file)>;
+    void get(const std::string &path, IoBackend &io, Ready ready);
+
+    const Stats &stats() const { return stats_; }
+
+private:
+    struct Entry {
+        std::string path;
+        CachedFilePtr file;
+        size_t bytes;
+    };
+
+    static CachedFilePtr build(std::string data, const struct stat &st);
+    void insert(const std::string &path, CachedFilePtr file);
+    void erase(std::list<Entry>::iterator it);
+
+    size_t budget_;
+    std::list<Entry> lru_; // 前端為最近使用
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    // 讀取中的檔案與等待結果的請求
+    std::unordered_map<std::string, std::vector<Ready>> loading_;
+    Stats stats_;
+};
@@ -0,0 +1,121 @@
+#include "event_loop.hpp"
+
+#include <sys/epoll.h>
+#include <unistd.h>
+
+#include <iostream>
+
+EventLoop::EventLoop() : epfd_(epoll_create1(EPOLL_CLOEXEC)) {}
+
+EventLoop::~EventLoop()
+{
+    close(epfd_);
+}
+
+void EventLoop::watch(int fd, std::function<void()> on_readable)
+{
+    watchers_[fd] = std::move(on_readable);
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = fd;
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+}
+
+void EventLoop::unwatch(int fd)
+{
+    epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+    watchers_.erase(fd);
+}
+
+EventLoop::TimerId EventLoop::addTimer(int timeout_ms, std::function<void()> cb)
+{
+    return timers_.emplace(Clock::now() + std::chrono::milliseconds(timeout_ms),
+                           std::move(cb));
+}
+
+void EventLoop::cancelTimer(TimerId id)
+{
+    timers_.erase(id);
+}
+
+EventLoop::Detached EventLoop::drive(Task<void> task,
+                                     std::exception_ptr &error,
+                                     bool &done)
+{
+    try {
+        co_await task;
+    } catch (...) {
+        error = std::current_exception();
+    }
+    done = true;
+}
+
+EventLoop::Detached EventLoop::driveSpawned(Task<void> task, size_t &active)
+{
+    ++active;
+    try {
+        co_await task;
+    } catch (const std::exception &e) {
+        std::cerr << "⚠️ 背景 task 拋出例外，已忽略：" << e.what() << "\n";
+    } catch (...) {
+        std::cerr << "⚠️ 背景 task 拋出未知例外，已忽略\n";
+    }
+    --active;
+}
+
+void EventLoop::spawn(Task<void> task)
+{
+    driveSpawned(std::move(task), active_);
+}
+
+void EventLoop::run()
+{
+    while (active_ > 0)
+        runOnce();
+}
+
+void EventLoop::runUntilComplete(Task<void> task)
+{
+    std::exception_ptr error;
+    bool done = false;
+    drive(std::move(task), error, done);
+    while (!done)
+        runOnce();
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void EventLoop::runOnce()
+{
+    int timeout_ms = -1;
+    if (!ready_.empty()) {
+        timeout_ms = 0;
+    } else if (!timers_.empty()) {
+        auto wait = timers_.begin()->first - Clock::now();
+        timeout_ms = std::max<long>(
+            0, std::chrono::ceil<std::chrono::milliseconds>(wait).count());
+    }
+
+    epoll_event events[64];
+    int n = epoll_wait(epfd_, events, 64, timeout_ms);
+    for (int i = 0; i < n; ++i) {
+        auto it = watchers_.find(events[i].data.fd);
+        if (it != watchers_.end())
+            it->second();
+    }
+
+    // 先從 multimap 取出再執行，callback 內可以安全地新增或取消其他計時器
+    auto now = Clock::now();
+    while (!timers_.empty() && timers_.begin()->first <= now) {
+        std::function<void()> cb = std::move(timers_.begin()->second);
+        timers_.erase(timers_.begin());
+        cb();
+    }
+
+    // 只執行這一輪開始時已就緒的 coroutine，新排入的留到下一輪
+    for (size_t i = ready_.size(); i > 0; --i) {
+        std::coroutine_handle<> h = ready_.front();
+        ready_.pop_front();
+        h.resume();
+    }
+}
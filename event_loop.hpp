@@ -0,0 +1,169 @@
+#pragma once
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <map>
+#include <optional>
+#include <unordered_map>
+
+#include "task.hpp"
+
+// 單執行緒事件迴圈：epoll 監看 fd、multimap 管理計時器，
+// 就緒的 coroutine 一律排進 ready_ 佇列再依序 resume，避免在 callback 中重入。
+class EventLoop
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimerId = std::multimap<Clock::time_point,
+                                  std::function<void()>>::iterator;
+
+    EventLoop();
+    ~EventLoop();
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    void watch(int fd, std::function<void()> on_readable);
+    void unwatch(int fd);
+
+    TimerId addTimer(int timeout_ms, std::function<void()> cb);
+    void cancelTimer(TimerId id);
+
+    void schedule(std::coroutine_handle<> h) { ready_.push_back(h); }
+
+    // 在背景執行 task；run() 會跑到所有 spawn 出去的 task 都結束。
+    // 沒有人等待其結果，task 拋出的例外記錄後丟棄
+    void spawn(Task<void> task);
+    void run();
+
+    // 執行事件迴圈直到 task 完成並回傳其結果；task 拋出的例外在這裡重新拋出
+    template <typename T>
+    T runUntilComplete(Task<T> task);
+    void runUntilComplete(Task<void> task);
+
+    // co_await loop.sleep(ms)
+    auto sleep(int timeout_ms)
+    {
+        struct Awaiter {
+            EventLoop &loop;
+            int ms;
+            bool await_ready() const noexcept { return ms <= 0; }
+            void await_suspend(std::coroutine_handle<> h)
+            {
+                loop.addTimer(ms, [this, h] { loop.schedule(h); });
+            }
+            void await_resume() noexcept {}
+        };
+        return Awaiter{*this, timeout_ms};
+    }
+
+private:
+    // spawn() 與 runUntilComplete() 用來驅動 Task 的自我銷毀 coroutine；
+    // drive 系列會接住 task 的例外，不會走到 unhandled_exception()
+    struct Detached {
+        struct promise_type {
+            Detached get_return_object() { return {}; }
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_never final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception() { std::terminate(); }
+        };
+    };
+    template <typename T>
+    static Detached drive(Task<T> task,
+                          std::optional<T> &out,
+                          std::exception_ptr &error,
+                          bool &done);
+    static Detached drive(Task<void> task,
+                          std::exception_ptr &error,
+                          bool &done);
+    static Detached driveSpawned(Task<void> task, size_t &active);
+
+    // 處理一輪：等待 I/O 或最近的計時器，再執行所有就緒的 coroutine
+    void runOnce();
+
+    int epfd_;
+    std::unordered_map<int, std::function<void()>> watchers_;
+    std::multimap<Clock::time_point, std::function<void()>> timers_;
+    std::deque<std::coroutine_handle<>> ready_;
+    size_t active_ = 0;
+};
+
+// 一次性的事件：coroutine 以 co_await ev.wait(timeout_ms) 等待 set()，
+// 逾時回傳 false
+class Event
+{
+public:
+    explicit Event(EventLoop &loop) : loop_(loop) {}
+
+    void set()
+    {
+        set_ = true;
+        if (waiter_)
+            loop_.schedule(std::exchange(waiter_, {}));
+    }
+    void reset() { set_ = false; }
+    bool isSet() const { return set_; }
+
+    auto wait(int timeout_ms)
+    {
+        struct Awaiter {
+            Event &ev;
+            int ms;
+            std::optional<EventLoop::TimerId> timer;
+
+            bool await_ready() const noexcept { return ev.set_; }
+            void await_suspend(std::coroutine_handle<> h)
+            {
+                ev.waiter_ = h;
+                if (ms >= 0)
+                    timer = ev.loop_.addTimer(ms, [this] {
+                        timer.reset();
+                        if (ev.waiter_)
+                            ev.loop_.schedule(std::exchange(ev.waiter_, {}));
+                    });
+            }
+            bool await_resume()
+            {
+                if (timer)
+                    ev.loop_.cancelTimer(*timer);
+                return ev.set_;
+            }
+        };
+        return Awaiter{*this, timeout_ms, std::nullopt};
+    }
+
+private:
+    EventLoop &loop_;
+    bool set_ = false;
+    std::coroutine_handle<> waiter_;
+};
+
+template <typename T>
+EventLoop::Detached EventLoop::drive(Task<T> task,
+                                     std::optional<T> &out,
+                                     std::exception_ptr &error,
+                                     bool &done)
+{
+    try {
+        out = co_await task;
+    } catch (...) {
+        error = std::current_exception();
+    }
+    done = true;
+}
+
+template <typename T>
+T EventLoop::runUntilComplete(Task<T> task)
+{
+    std::optional<T> out;
+    std::exception_ptr error;
+    bool done = false;
+    drive(std::move(task), out, error, done);
+    while (!done)
+        runOnce();
+    if (error)
+        std::rethrow_exception(error);
+    return std::move(*out);
+}
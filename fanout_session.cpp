@@ -0,0 +1,289 @@
+#include "fanout_session.hpp"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <iostream>
+
+FanoutSession::FanoutSession(uint32_t id,
+                             CachedFilePtr file,
+                             const Options &opts,
+                             SendScheduler &scheduler,
+                             Clock::time_point now)
+    : id_(id),
+      flow_("fanout#" + std::to_string(id)),
+      file_(std::move(file)),
+      opts_(opts),
+      scheduler_(scheduler),
+      started_(now),
+      deadline_(now + std::chrono::milliseconds(opts.gather_ms))
+{
+    if (opts_.group && opts_.rate)
+        scheduler_.setRate(flow_, opts_.rate);
+}
+
+// 本輪的 chunk 依遞增順序排入，range_pos 只需往前移動
+bool FanoutSession::Receiver::needs(uint32_t chunk)
+{
+    while (range_pos < missing.size() && missing[range_pos].second < chunk)
+        ++range_pos;
+    return range_pos < missing.size() && missing[range_pos].first <= chunk;
+}
+
+void FanoutSession::sendInfo(const Receiver &r)
+{
+    std::string group;
+    if (opts_.group) {
+        char ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &opts_.group->sin_addr, ip, sizeof(ip));
+        group = std::string(ip) + ":" +
+                std::to_string(ntohs(opts_.group->sin_port));
+    }
+    scheduler_.pushPriority(
+        r.addr, {id_, r.request_seq, 0, PacketType::FANOUT_INFO,
+                 std::to_string(file_->chunks.size()) + "|" + group});
+}
+
+void FanoutSession::join(const std::string &key,
+                         const sockaddr_in &addr,
+                         uint32_t request_seq)
+{
+    // multicast 時資料共用一條 flow，FLUSH 也排在同一條才會在資料之後送出
+    std::string flow = opts_.group ? flow_ : flow_ + "@" + key;
+    auto [it, inserted] =
+        receivers_.try_emplace(key, Receiver{addr, request_seq, flow});
+    if (inserted && !opts_.group && opts_.rate)
+        scheduler_.setRate(flow, opts_.rate);
+    sendInfo(it->second);
+    std::cout << "📡 " << key << " 加入 fan-out #" << id_ << "（"
+              << receivers_.size() << " 個接收者）\n";
+}
+
+bool FanoutSession::rejoin(const std::string &key, uint32_t request_seq)
+{
+    auto it = receivers_.find(key);
+    if (it == receivers_.end() || it->second.request_seq != request_seq)
+        return false;
+    sendInfo(it->second);
+    return true;
+}
+
+FanoutSession::Clock::time_point FanoutSession::deadline() const
+{
+    // 送出中：排程器的佇列低於目標時需要立即補充
+    if (phase_ == Phase::Sending && queued() < kQueueTarget)
+        return Clock::time_point{};
+    return deadline_;
+}
+
+void FanoutSession::poll(Clock::time_point now)
+{
+    switch (phase_) {
+    case Phase::Gathering:
+        if (now < deadline_)
+            return;
+        for (auto &[key, r] : receivers_)
+            if (!file_->chunks.empty())
+                r.missing = {{0, uint32_t(file_->chunks.size() - 1)}};
+        startRound(now);
+        break;
+
+    case Phase::Sending:
+        // 送出中只等排程器消化佇列，沒有真正的計時器；每次都把 deadline_
+        // 往後延，一輪送超過 kFlushTimeout 時主迴圈才不會以 0 逾時空轉
+        deadline_ = now + kFlushTimeout;
+        pump(now);
+        break;
+
+    case Phase::Flushing:
+        // 接收者收齊時會主動回報，可能在 FLUSH 送出前就都完成了
+        if (allHeard()) {
+            finishRound(now);
+            return;
+        }
+        if (now < deadline_)
+            return;
+        // FLUSH 還在排程器裡等著送出，從真正送出後才開始計時
+        if (queued() > 0) {
+            deadline_ = now + kFlushTimeout;
+            return;
+        }
+        finishRound(now);
+        break;
+
+    case Phase::Done:
+        break;
+    }
+}
+
+void FanoutSession::startRound(Clock::time_point now)
+{
+    // 各接收者缺漏的聯集：同一個 chunk 不論多少人遺失都只排一次
+    std::vector<bool> wanted(file_->chunks.size());
+    size_t receivers = 0;
+    for (auto &[key, r] : receivers_) {
+        r.range_pos = 0;
+        r.heard = false;
+        if (r.complete || r.missing.empty())
+            continue;
+        ++receivers;
+        for (const auto &[first, last] : r.missing)
+            std::fill(wanted.begin() + first, wanted.begin() + last + 1, true);
+    }
+    pending_.clear();
+    for (uint32_t c = 0; c < wanted.size(); ++c)
+        if (wanted[c])
+            pending_.push_back(c);
+    cursor_ = 0;
+
+    ++round_;
+    std::cout << "📡 fan-out #" << id_ << " 第 " << round_ << " 輪：送出 "
+              << pending_.size() << " 個 chunk 給 " << receivers << " 個接收者"
+              << (opts_.group ? "（multicast）" : "") << "\n";
+    phase_ = Phase::Sending;
+    deadline_ = now + kFlushTimeout;
+    pump(now);
+}
+
+void FanoutSession::pump(Clock::time_point now)
+{
+    while (cursor_ < pending_.size() && queued() < kQueueTarget) {
+        uint32_t chunk = pending_[cursor_++];
+        Packet pkt{chunk, id_, 0, PacketType::FANOUT_DATA, ""};
+        size_t copies = 0;
+        if (opts_.group) {
+            scheduler_.pushBulk(flow_, *opts_.group, pkt, file_->chunks[chunk],
+                                file_);
+            copies = 1;
+        } else {
+            for (auto &[key, r] : receivers_) {
+                if (r.complete || !r.needs(chunk))
+                    continue;
+                scheduler_.pushBulk(r.flow, r.addr, pkt, file_->chunks[chunk],
+                                    file_);
+                ++copies;
+            }
+        }
+        data_sent_ += copies;
+        if (round_ > 1)
+            repairs_sent_ += copies;
+    }
+    if (cursor_ == pending_.size())
+        sendFlush(now);
+}
+
+void FanoutSession::sendFlush(Clock::time_point now)
+{
+    // 與資料排在同一個 flow，一定在本輪所有 chunk 之後送出
+    for (auto &[key, r] : receivers_)
+        if (!r.complete)
+            scheduler_.pushBulk(
+                r.flow, r.addr,
+                {round_, id_, 0, PacketType::FANOUT_FLUSH, ""});
+    phase_ = Phase::Flushing;
+    deadline_ = now + kFlushTimeout;
+}
+
+void FanoutSession::onNak(const std::string &key,
+                          const Packet &nak,
+                          Clock::time_point now)
+{
+    auto it = receivers_.find(key);
+    if (it == receivers_.end() || phase_ == Phase::Done)
+        return;
+    Receiver &r = it->second;
+
+    // 接收端不認得這個 session（FANOUT_INFO 遺失）：重送 FANOUT_INFO。
+    // 不算回應，已經放棄下載的接收端照樣在幾輪後被移出
+    if (nak.payload == kNakUnknownSession) {
+        sendInfo(r);
+        return;
+    }
+    r.silent_rounds = 0;
+
+    // 空的 NAK 表示已收齊；接收端收齊時也會主動送出一次
+    if (nak.payload.empty() || file_->chunks.empty()) {
+        r.complete = true;
+        r.missing.clear();
+    } else if (phase_ == Phase::Flushing && nak.seq == round_) {
+        uint32_t last_chunk = uint32_t(file_->chunks.size() - 1);
+        r.missing.clear();
+        for (const auto &[first, last] : parseRanges(nak.payload))
+            if (first <= last_chunk)
+                r.missing.emplace_back(first, std::min(last, last_chunk));
+        std::sort(r.missing.begin(), r.missing.end());
+        r.heard = true;
+    } else {
+        // 上一輪遲到的 NAK，缺漏會在這一輪的 FLUSH 重新回報
+        return;
+    }
+
+    // 所有人都回報了就立即開始下一輪，不必等到逾時
+    if (phase_ == Phase::Flushing && allHeard())
+        finishRound(now);
+}
+
+bool FanoutSession::allHeard() const
+{
+    return std::all_of(receivers_.begin(), receivers_.end(),
+                       [](const auto &kv) {
+                           return kv.second.complete || kv.second.heard;
+                       });
+}
+
+void FanoutSession::finishRound(Clock::time_point now)
+{
+    for (auto it = receivers_.begin(); it != receivers_.end();) {
+        Receiver &r = it->second;
+        // 沒有回應的接收者保留上一次回報的缺漏，下一輪照樣重送給它
+        if (!r.complete && !r.heard &&
+            ++r.silent_rounds >= kMaxSilentRounds) {
+            std::cout << "❌ fan-out #" << id_ << "：" << it->first << " 連續 "
+                      << r.silent_rounds << " 輪沒有回應，移出接收者\n";
+            ++dropped_;
+            releaseFlow(r.flow);
+            it = receivers_.erase(it);
+            continue;
+        }
+        ++it;
+    }
+
+    bool all_complete =
+        std::all_of(receivers_.begin(), receivers_.end(),
+                    [](const auto &kv) { return kv.second.complete; });
+    if (!all_complete) {
+        startRound(now);
+        return;
+    }
+
+    auto ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - started_)
+            .count();
+    std::cout << "✅ fan-out #" << id_ << " 完成：" << receivers_.size()
+              << " 個接收者收齊";
+    if (dropped_ > 0)
+        std::cout << "（放棄 " << dropped_ << " 個）";
+    std::cout << "，" << round_ << " 輪，送出 " << data_sent_
+              << " 個資料封包（其中修補 " << repairs_sent_ << " 個），耗時 "
+              << ms << " ms\n";
+    phase_ = Phase::Done;
+    for (const auto &[key, r] : receivers_)
+        releaseFlow(r.flow);
+    releaseFlow(flow_);
+}
+
+size_t FanoutSession::queued() const
+{
+    if (opts_.group)
+        return scheduler_.queued(flow_);
+    size_t n = 0;
+    for (const auto &[key, r] : receivers_)
+        n += scheduler_.queued(r.flow);
+    return n;
+}
+
+void FanoutSession::releaseFlow(const std::string &flow)
+{
+    if (opts_.rate)
+        scheduler_.clearRate(flow);
+}
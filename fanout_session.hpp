@@ -0,0 +1,113 @@
+#pragma once
+#include <netinet/in.h>
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "content_cache.hpp"
+#include "packet.hpp"
+#include "send_scheduler.hpp"
+
+// 一群 client 同時下載同一個檔案時的 fan-out 傳送（NAK 式的可靠傳輸）。
+//
+// 第一個 FANOUT_REQ 建立 session，收集期間內請求同一個檔案的 client 都加入。
+// 之後每一輪把需要的 chunk 各送一次：啟用 multicast 時送到群組位址，
+// 否則依同一份排程逐一送給需要它的接收者。一輪送完後以 FANOUT_FLUSH 要求
+// 每個接收者回報缺少的範圍，下一輪只送這些範圍的聯集，所有人都收齊即結束。
+// 沒有逐封包的 ACK，也不做壅塞控制；資料以 Options::rate 在 SendScheduler 中
+// 限速（unicast 時每個接收者一條 flow，multicast 時整個群組一條）。
+class FanoutSession
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        // 第一個請求之後等待其他接收者加入的時間
+        int gather_ms = 200;
+        // 設定時資料以 IP multicast 送到這個群組
+        std::optional<sockaddr_in> group;
+        // 每個接收者（multicast 時為整個群組）的送出速率上限，bytes/s；
+        // 0 表示沿用排程器的 rate_cap
+        uint64_t rate = 0;
+    };
+
+    FanoutSession(uint32_t id,
+                  CachedFilePtr file,
+                  const Options &opts,
+                  SendScheduler &scheduler,
+                  Clock::time_point now);
+
+    // 加入並回覆 FANOUT_INFO；只有收集期間可以加入新的接收者
+    void join(const std::string &key,
+              const sockaddr_in &addr,
+              uint32_t request_seq);
+    // 已加入的 client 重送同一個請求（FANOUT_INFO 遺失）時重送 FANOUT_INFO
+    bool rejoin(const std::string &key, uint32_t request_seq);
+    void onNak(const std::string &key,
+               const Packet &nak,
+               Clock::time_point now);
+    // 推進計時器，並在排程器有空間時排入下一批 chunk
+    void poll(Clock::time_point now);
+
+    bool gathering() const { return phase_ == Phase::Gathering; }
+    bool done() const { return phase_ == Phase::Done; }
+    Clock::time_point deadline() const;
+
+private:
+    enum class Phase { Gathering, Sending, Flushing, Done };
+
+    struct Receiver {
+        sockaddr_in addr;
+        uint32_t request_seq;
+        // 送給它的資料與 FLUSH 所在的排程器 flow
+        std::string flow;
+        // 最近一次回報的缺漏（已排序），本輪只送這些 chunk 給它
+        std::vector<ChunkRange> missing;
+        size_t range_pos = 0;
+        bool heard = false;
+        bool complete = false;
+        int silent_rounds = 0;
+
+        bool needs(uint32_t chunk);
+    };
+
+    void sendInfo(const Receiver &r);
+    void startRound(Clock::time_point now);
+    void pump(Clock::time_point now);
+    void sendFlush(Clock::time_point now);
+    void finishRound(Clock::time_point now);
+    bool allHeard() const;
+    // 本 session 還在排程器中等著送出的封包數
+    size_t queued() const;
+    // 離開排程器的 flow：移除專屬的速率設定
+    void releaseFlow(const std::string &flow);
+
+    // 等待 NAK 的上限，與 FileTransfer 的 RTO 相同
+    static constexpr std::chrono::milliseconds kFlushTimeout{1000};
+    // 連續這麼多輪沒有回應的接收者移出 session
+    static constexpr int kMaxSilentRounds = 5;
+    // 排程器中最多保留的封包數，其餘等送出後再排入
+    static constexpr size_t kQueueTarget = 256;
+
+    const uint32_t id_;
+    const std::string flow_;
+    CachedFilePtr file_;
+    Options opts_;
+    SendScheduler &scheduler_;
+    std::unordered_map<std::string, Receiver> receivers_;
+
+    Phase phase_ = Phase::Gathering;
+    Clock::time_point started_;
+    Clock::time_point deadline_;
+    uint32_t round_ = 0;
+    // 本輪要送的 chunk（各接收者缺漏的聯集），cursor_ 之前的已排入排程器
+    std::vector<uint32_t> pending_;
+    size_t cursor_ = 0;
+
+    uint64_t data_sent_ = 0;
+    uint64_t repairs_sent_ = 0;
+    size_t dropped_ = 0;
+};
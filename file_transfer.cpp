@@ -0,0 +1,323 @@
+#include "file_transfer.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+FileTransfer::FileTransfer(const std::string &flow,
+                           const sockaddr_in &client_addr,
+                           CachedFilePtr file,
+                           const ConnectionState &state,
+                           SendScheduler &scheduler,
+                           Tracer &tracer)
+    : flow_(flow),
+      client_addr_(client_addr),
+      file_(std::move(file)),
+      scheduler_(scheduler),
+      tracer_(tracer),
+      window_size_(state.window_size),
+      peer_window_scale_(state.peer_window_scale),
+      peer_window_(state.peer_window),
+      first_seq_(state.client_seq + 1),
+      total_(file_->chunks.size()),
+      // ssthresh 初始為通告視窗，讓 slow start 在高 BDP 的路徑上可以一路
+      // 成長到 receiver 允許的大小
+      ssthresh_(std::max<size_t>(state.peer_window, 2))
+{
+}
+
+Packet FileTransfer::makePacket(uint32_t seq, PacketType type) const
+{
+    return Packet{seq, first_seq_ - 1, window_size_, type, ""};
+}
+
+// FILE_DATA 的 payload 直接指向 cache 中的檔案內容，不複製
+void FileTransfer::sendChunk(size_t chunk)
+{
+    scheduler_.pushBulk(flow_, client_addr_,
+                        makePacket(first_seq_ + chunk, PacketType::FILE_DATA),
+                        file_->chunks[chunk], file_);
+}
+
+void FileTransfer::traceMetrics()
+{
+    tracer_.record(client_addr_, TraceEvent::MetricsUpdated, 0,
+                   uint32_t(in_flight_.size()), uint32_t(cwnd_),
+                   uint32_t(ssthresh_));
+}
+
+void FileTransfer::traceTimer(TraceTimer timer)
+{
+    tracer_.record(client_addr_, TraceEvent::TimerFired, 0,
+                   first_seq_ + uint32_t(next_chunk_), uint32_t(timer));
+}
+
+bool FileTransfer::owns(const Packet &ack) const
+{
+    // 同一條連線上接連的 FILE_REQ seq 相鄰，各傳輸的 seq 範圍會重疊，
+    // 只看 seq 會把 ACK 交給別的傳輸
+    return ack.ack == requestSeq() && ack.seq - 1 - first_seq_ <= total_;
+}
+
+void FileTransfer::start(Clock::time_point now)
+{
+    advance(now);
+}
+
+void FileTransfer::advance(Clock::time_point now)
+{
+    if (next_chunk_ == total_ && in_flight_.empty()) {
+        sendEnd(now);
+        return;
+    }
+    if (silent_rounds_ >= kMaxSilentRounds) {
+        std::cout << "❌ client 連續 " << silent_rounds_
+                  << " 輪沒有回應，放棄傳輸\n";
+        phase_ = Phase::Done;
+        return;
+    }
+    // 🪟 zero window：client 的 reorder buffer 已滿，暫停送出新資料
+    if (peer_window_ == 0 && in_flight_.empty()) {
+        sendProbe(now);
+        return;
+    }
+    persist_ms_ = kMinPersistMs;
+    fillWindow(now);
+}
+
+void FileTransfer::fillWindow(Clock::time_point now)
+{
+    // 仍在途中（上一輪重傳）的封包也佔用視窗
+    size_t send_limit = std::min<size_t>(cwnd_, peer_window_);
+    size_t first_new = next_chunk_;
+    while (in_flight_.size() < send_limit && next_chunk_ < total_) {
+        in_flight_.push_back(
+            makePacket(first_seq_ + next_chunk_, PacketType::FILE_DATA));
+        sendChunk(next_chunk_++);
+    }
+    // 一輪可能有上萬個封包，只記一行摘要，逐封包的 log 在真正送出時才輸出
+    std::cout << "📤 傳送 " << next_chunk_ - first_new << " 個新封包（seq 從 "
+              << first_seq_ + first_new << " 起，另有重傳 "
+              << in_flight_.size() - (next_chunk_ - first_new)
+              << " 個）cwnd=" << cwnd_ << " rwnd=" << peer_window_ << "\n";
+
+    cwnd_limited_ = in_flight_.size() >= cwnd_;
+    round_pending_.clear();
+    for (const Packet &p : in_flight_)
+        round_pending_.insert(p.seq);
+    round_acked_.clear();
+    round_heard_ = false;
+    round_started_ = now;
+    rtt_sampled_ = false;
+    phase_ = Phase::Sending;
+    deadline_ = now + kRto;
+    traceMetrics();
+}
+
+// 改重送上一個 chunk 當 window probe，client 的 ACK 會帶回最新的視窗
+void FileTransfer::sendProbe(Clock::time_point now)
+{
+    size_t probe = next_chunk_ > 0 ? next_chunk_ - 1 : 0;
+    std::cout << "🪟 zero window，送出 window probe seq=" << first_seq_ + probe
+              << "\n";
+    sendChunk(probe);
+    phase_ = Phase::Probing;
+    deadline_ = now + kRto;
+}
+
+void FileTransfer::sendEnd(Clock::time_point now)
+{
+    scheduler_.pushBulk(flow_, client_addr_,
+                        makePacket(first_seq_ + total_, PacketType::FILE_END));
+    std::cout << "📤 傳送 FILE_END 給 client\n";
+    phase_ = Phase::Ending;
+    deadline_ = now + kRto;
+}
+
+void FileTransfer::onAck(const Packet &ack, Clock::time_point now)
+{
+    // 每個 ACK 都帶著 client 當下的可用空間，以最後收到的為準
+    peer_window_ = uint32_t(ack.window) << peer_window_scale_;
+
+    switch (phase_) {
+    case Phase::Sending:
+        round_heard_ = true;
+        if (round_pending_.erase(ack.seq - 1)) {
+            round_acked_.insert(ack.seq);
+            if (!rtt_sampled_) {
+                // 與 TCP 相同的 EWMA：srtt = 7/8 srtt + 1/8 rtt
+                uint32_t rtt_us = uint32_t(
+                    std::chrono::duration_cast<std::chrono::microseconds>(
+                        now - round_started_)
+                        .count());
+                srtt_us_ = srtt_us_ ? (7 * uint64_t(srtt_us_) + rtt_us) / 8
+                                    : rtt_us;
+                rtt_sampled_ = true;
+                tracer_.record(client_addr_, TraceEvent::RttUpdated, 0,
+                               ack.seq - 1, rtt_us, srtt_us_);
+            }
+        }
+        tracer_.record(client_addr_, TraceEvent::AckReceived,
+                       uint8_t(PacketType::DATA_ACK), ack.seq - 1,
+                       peer_window_, uint32_t(round_pending_.size()));
+        // 本輪的封包都被 ACK 了，不必等到逾時
+        if (round_pending_.empty())
+            finishRound(now);
+        break;
+
+    case Phase::Probing:
+    case Phase::Persist:
+        silent_rounds_ = 0;
+        if (peer_window_ > 0) {
+            advance(now);
+        } else if (phase_ == Phase::Probing) {
+            // 視窗仍為 0：persist timer 以指數退避拉長下一次 probe 的間隔
+            phase_ = Phase::Persist;
+            deadline_ = now + std::chrono::milliseconds(persist_ms_);
+            persist_ms_ = std::min(persist_ms_ * 2, kMaxPersistMs);
+        }
+        break;
+
+    case Phase::Ending:
+        tracer_.record(client_addr_, TraceEvent::AckReceived,
+                       uint8_t(PacketType::DATA_ACK), ack.seq - 1,
+                       peer_window_);
+        if (ack.seq == first_seq_ + total_ + 1) {
+            std::cout << "✅ FILE_END 被 ACK\n";
+            phase_ = Phase::Done;
+        }
+        break;
+
+    case Phase::Done:
+        break;
+    }
+}
+
+void FileTransfer::onTimer(Clock::time_point now)
+{
+    if (now < deadline_)
+        return;
+
+    switch (phase_) {
+    case Phase::Sending:
+        // 封包還在排程器裡等著送出，RTO 從真正送出後才開始算
+        if (scheduler_.queued(flow_) > 0) {
+            deadline_ = now + kRto;
+            return;
+        }
+        traceTimer(TraceTimer::Rto);
+        finishRound(now);
+        break;
+
+    case Phase::Probing:
+        traceTimer(TraceTimer::Probe);
+        ++silent_rounds_;
+        advance(now);
+        break;
+
+    case Phase::Persist:
+        traceTimer(TraceTimer::Persist);
+        sendProbe(now);
+        break;
+
+    case Phase::Ending:
+        traceTimer(TraceTimer::FileEnd);
+        if (end_attempts_ >= kMaxEndAttempts) {
+            std::cout << "❌ FILE_END 未被 ACK，傳輸可能不完整\n";
+            phase_ = Phase::Done;
+            return;
+        }
+        std::cout << "🔁 重傳 FILE_END（第 " << ++end_attempts_ << " 次）\n";
+        scheduler_.pushBulk(
+            flow_, client_addr_,
+            makePacket(first_seq_ + total_, PacketType::FILE_END));
+        deadline_ = now + kRto;
+        break;
+
+    case Phase::Done:
+        break;
+    }
+}
+
+void FileTransfer::finishRound(Clock::time_point now)
+{
+    silent_rounds_ = round_heard_ ? 0 : silent_rounds_ + 1;
+    std::vector<Packet> unacked;
+    size_t newly_acked = 0;
+
+    for (Packet &p : in_flight_) {
+        if (round_acked_.count(p.seq + 1)) {
+            uint32_t ack_seq = p.seq + 1;
+            acked_seqs_.insert(ack_seq);
+            ++newly_acked;
+
+            if (ack_seq == last_ack_seq_) {
+                duplicate_ack_count_++;
+                std::cout << "🔁 Duplicate ACK #" << duplicate_ack_count_
+                          << "\n";
+                if (duplicate_ack_count_ == 3 && !in_fast_recovery_) {
+                    std::cout << "🚨 Fast Retransmit triggered for seq="
+                              << p.seq << "\n";
+                    ssthresh_ = std::max(cwnd_ / 2, size_t(1));
+                    cwnd_ = ssthresh_;
+                    in_fast_recovery_ = true;
+                    tracer_.record(client_addr_, TraceEvent::Retransmit,
+                                   uint8_t(PacketType::FILE_DATA), p.seq);
+                    sendChunk(p.seq - first_seq_);
+                }
+            } else {
+                duplicate_ack_count_ = 0;
+                last_ack_seq_ = ack_seq;
+                // slow start 每個 ACK 加 1（每輪翻倍），之後每輪加 1。
+                // 受 client 視窗或資料量限制（app-limited）而沒用滿 cwnd 的
+                // 輪次不增長：這些 ACK 證明不了更大的 cwnd 也不會壅塞
+                if (cwnd_limited_) {
+                    if (cwnd_ < ssthresh_) {
+                        cwnd_++;
+                    } else if (++avoidance_acks_ >= cwnd_) {
+                        cwnd_++;
+                        avoidance_acks_ = 0;
+                    }
+                }
+                if (in_fast_recovery_) {
+                    std::cout << "🎯 Fast Recovery complete\n";
+                    in_fast_recovery_ = false;
+                }
+            }
+            continue;
+        }
+
+        if (acked_seqs_.count(p.seq + 1)) {
+            std::cout << "⏭️ 已 ACK，跳過重傳 seq=" << p.seq << "\n";
+            continue;
+        }
+
+        std::cout << "⚠️ Timeout or loss for seq=" << p.seq << "\n";
+        tracer_.record(client_addr_, TraceEvent::PacketLost,
+                       uint8_t(PacketType::FILE_DATA), p.seq);
+        unacked.push_back(p);
+
+        // 同一輪的多個遺失視為一次壅塞事件，只退一次
+        if (unacked.size() == 1) {
+            ssthresh_ = std::max(cwnd_ / 2, size_t(2));
+            cwnd_ = 1;
+            avoidance_acks_ = 0;
+            std::cout << "📉 cwnd 退回至 1（ssthresh=" << ssthresh_ << "）\n";
+        }
+        in_fast_recovery_ = false;
+        duplicate_ack_count_ = 0;
+    }
+
+    std::cout << "✅ 本輪 ACK " << newly_acked << " 個，📈 cwnd 為 " << cwnd_
+              << "（ssthresh=" << ssthresh_ << "）\n";
+
+    for (Packet &p : unacked) {
+        std::cout << "🔁 重傳未 ACK 封包 seq=" << p.seq << "\n";
+        tracer_.record(client_addr_, TraceEvent::Retransmit,
+                       uint8_t(PacketType::FILE_DATA), p.seq);
+        sendChunk(p.seq - first_seq_);
+    }
+
+    // 重傳過的封包留在 in_flight_，下一輪繼續等它的 ACK
+    in_flight_ = std::move(unacked);
+    advance(now);
+}
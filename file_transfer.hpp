@@ -0,0 +1,106 @@
+#pragma once
+#include <netinet/in.h>
+
+#include <chrono>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "connection.hpp"
+#include "content_cache.hpp"
+#include "packet.hpp"
+#include "send_scheduler.hpp"
+#include "trace.hpp"
+
+// 一個 FILE_REQ 的傳送狀態機。由 server 主迴圈驅動，不會阻塞其他連線：
+// 收到屬於它的 DATA_ACK 時呼叫 onAck()，到了 deadline() 呼叫 onTimer()。
+//
+// 每一輪送出 min(cwnd, client 通告視窗) 個封包，收齊該輪的 ACK 或逾時後結算
+// （slow start / congestion avoidance / 重傳）。封包一律排進 SendScheduler
+// 的 bulk lane，與其他連線公平分享送出額度。
+class FileTransfer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    FileTransfer(const std::string &flow,
+                 const sockaddr_in &client_addr,
+                 CachedFilePtr file,
+                 const ConnectionState &state,
+                 SendScheduler &scheduler,
+                 Tracer &tracer);
+
+    void start(Clock::time_point now);
+    // ACK 帶回的請求 seq 相符，且 ack.seq - 1 落在資料或 FILE_END 範圍內
+    bool owns(const Packet &ack) const;
+    void onAck(const Packet &ack, Clock::time_point now);
+    void onTimer(Clock::time_point now);
+
+    Clock::time_point deadline() const { return deadline_; }
+    bool done() const { return phase_ == Phase::Done; }
+    uint32_t requestSeq() const { return first_seq_ - 1; }
+
+private:
+    enum class Phase { Sending, Probing, Persist, Ending, Done };
+
+    // 依目前的狀態決定下一步：送下一輪、zero window probe 或 FILE_END
+    void advance(Clock::time_point now);
+    void fillWindow(Clock::time_point now);
+    void finishRound(Clock::time_point now);
+    void sendProbe(Clock::time_point now);
+    void sendEnd(Clock::time_point now);
+    void sendChunk(size_t chunk);
+    void traceMetrics();
+    void traceTimer(TraceTimer timer);
+    Packet makePacket(uint32_t seq, PacketType type) const;
+
+    // 每輪等待 ACK 的上限（相當於 RTO，取 TCP 的初始值 1 秒）
+    static constexpr std::chrono::milliseconds kRto{1000};
+    // 連續這麼多輪收不到任何 ACK 就放棄傳輸
+    static constexpr int kMaxSilentRounds = 5;
+    static constexpr int kMaxEndAttempts = 5;
+    // zero window probe 的間隔範圍
+    static constexpr int kMinPersistMs = 200;
+    static constexpr int kMaxPersistMs = 5000;
+
+    std::string flow_;
+    sockaddr_in client_addr_;
+    CachedFilePtr file_;
+    SendScheduler &scheduler_;
+    Tracer &tracer_;
+    uint16_t window_size_;
+    uint8_t peer_window_scale_;
+    uint32_t peer_window_;
+
+    // 資料封包的 seq 從請求的 seq + 1 開始連續配置，seq - first_seq_ 即為
+    // chunk 索引；FILE_END 的 seq 為 first_seq_ + total_
+    const uint32_t first_seq_;
+    const size_t total_;
+    size_t next_chunk_ = 0;
+
+    size_t cwnd_ = 1;
+    size_t ssthresh_;
+    size_t avoidance_acks_ = 0;
+    size_t duplicate_ack_count_ = 0;
+    uint32_t last_ack_seq_ = 0;
+    bool in_fast_recovery_ = false;
+    // 受 client 視窗限制而沒用滿 cwnd 的輪次不增長 cwnd（RFC 7661）
+    bool cwnd_limited_ = false;
+    int silent_rounds_ = 0;
+    int persist_ms_ = kMinPersistMs;
+    int end_attempts_ = 0;
+
+    std::vector<Packet> in_flight_;
+    // 本輪還在等 ACK 的 seq、本輪收到的 ACK（以 ack.seq 記錄）
+    std::unordered_set<uint32_t> round_pending_;
+    std::unordered_set<uint32_t> round_acked_;
+    bool round_heard_ = false;
+    // 每輪第一個 ACK 的往返時間（含在排程器中排隊的時間）作為 RTT 樣本
+    Clock::time_point round_started_;
+    bool rtt_sampled_ = false;
+    uint32_t srtt_us_ = 0;
+    std::unordered_set<uint32_t> acked_seqs_;
+
+    Phase phase_ = Phase::Sending;
+    Clock::time_point deadline_;
+};
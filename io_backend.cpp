@@ -0,0 +1,703 @@
+#include "io_backend.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+constexpr size_t kMaxDatagram = IoBackend::kMaxDatagram;
+constexpr size_t kBatch = 64;
+} // namespace
+
+bool IoBackend::receive(Datagram &out, int timeout_ms)
+{
+    if (pending_.empty()) {
+        // 送出時順便收割的完成事件可能已經帶來新的 datagram
+        flush();
+        if (pending_.empty())
+            fill(timeout_ms);
+    }
+    if (pending_.empty())
+        return false;
+    out = std::move(pending_.front());
+    pending_.pop_front();
+    return true;
+}
+
+void IoBackend::dropTruncated(const sockaddr_in &from)
+{
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &from.sin_addr, ip, sizeof(ip));
+    std::cerr << "⚠️ datagram 超過 " << kMaxDatagram << " bytes 被截斷，已丟棄 ← "
+              << ip << ":" << ntohs(from.sin_port) << "（累計 " << ++truncated_
+              << " 個）\n";
+}
+
+void IoBackend::queueSendChunk(const sockaddr_in &to,
+                               std::string header,
+                               std::string_view payload,
+                               std::shared_ptr<const void>)
+{
+    header.append(payload);
+    queueSend(to, std::move(header));
+}
+
+// 沒有非同步檔案 I/O 的後端直接讀完，結果同樣留到 completeReads() 才交出
+void IoBackend::readFile(const std::string &path, ReadDone done)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        finished_reads_.push_back({std::move(done), false, {}});
+        return;
+    }
+    std::ostringstream oss;
+    oss << file.rdbuf();
+    finished_reads_.push_back({std::move(done), true, oss.str()});
+}
+
+size_t IoBackend::completeReads()
+{
+    // 先取出再執行，callback 中發出的新讀取留到下一次
+    std::deque<FinishedRead> ready;
+    ready.swap(finished_reads_);
+    for (FinishedRead &r : ready)
+        r.done(r.ok, std::move(r.data));
+    return ready.size();
+}
+
+// ---------------------------------------------------------------------------
+// socket：原本的 sendto/recvfrom，一次一個封包
+// ---------------------------------------------------------------------------
+class SocketBackend : public IoBackend
+{
+public:
+    using IoBackend::IoBackend;
+
+    const char *name() const override { return "socket"; }
+
+    void queueSend(const sockaddr_in &to, std::string data) override
+    {
+        sendto(sockfd_, data.data(), data.size(), 0, (const sockaddr *) &to,
+               sizeof(to));
+    }
+
+    void queueSendChunk(const sockaddr_in &to,
+                        std::string header,
+                        std::string_view payload,
+                        std::shared_ptr<const void>) override
+    {
+        iovec iov[2] = {{header.data(), header.size()},
+                        {const_cast<char *>(payload.data()), payload.size()}};
+        msghdr msg{};
+        msg.msg_name = const_cast<sockaddr_in *>(&to);
+        msg.msg_namelen = sizeof(to);
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+        sendmsg(sockfd_, &msg, 0);
+    }
+
+    void flush() override {}
+
+protected:
+    void fill(int timeout_ms) override
+    {
+        pollfd pfd{sockfd_, POLLIN, 0};
+        if (poll(&pfd, 1, timeout_ms) <= 0)
+            return;
+
+        char buffer[kMaxDatagram];
+        Datagram d{};
+        socklen_t len = sizeof(d.addr);
+        // MSG_TRUNC：回傳 datagram 的實際長度，超過 buffer 即表示被截斷
+        ssize_t n = recvfrom(sockfd_, buffer, sizeof(buffer), MSG_TRUNC,
+                             (sockaddr *) &d.addr, &len);
+        if (n <= 0)
+            return;
+        if (size_t(n) > sizeof(buffer)) {
+            dropTruncated(d.addr);
+            return;
+        }
+        d.data.assign(buffer, n);
+        pending_.push_back(std::move(d));
+    }
+};
+
+// ---------------------------------------------------------------------------
+// epoll：non-blocking socket，recvmmsg / sendmmsg 批次收送
+// ---------------------------------------------------------------------------
+class EpollBackend : public IoBackend
+{
+public:
+    explicit EpollBackend(int sockfd) : IoBackend(sockfd)
+    {
+        fcntl(sockfd_, F_SETFL, fcntl(sockfd_, F_GETFL) | O_NONBLOCK);
+        epfd_ = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = sockfd_;
+        epoll_ctl(epfd_, EPOLL_CTL_ADD, sockfd_, &ev);
+    }
+
+    ~EpollBackend() override
+    {
+        flush();
+        close(epfd_);
+    }
+
+    const char *name() const override { return "epoll"; }
+
+    void queueSend(const sockaddr_in &to, std::string data) override
+    {
+        outq_.push_back({to, std::move(data), {}, nullptr});
+        if (outq_.size() >= kBatch)
+            flush();
+    }
+
+    void queueSendChunk(const sockaddr_in &to,
+                        std::string header,
+                        std::string_view payload,
+                        std::shared_ptr<const void> owner) override
+    {
+        outq_.push_back({to, std::move(header), payload, std::move(owner)});
+        if (outq_.size() >= kBatch)
+            flush();
+    }
+
+    void flush() override
+    {
+        size_t done = 0;
+        while (done < outq_.size()) {
+            size_t n = std::min(kBatch, outq_.size() - done);
+            mmsghdr msgs[kBatch];
+            iovec iov[kBatch][2];
+            for (size_t i = 0; i < n; ++i) {
+                OutMsg &m = outq_[done + i];
+                iov[i][0] = {m.head.data(), m.head.size()};
+                iov[i][1] = {const_cast<char *>(m.body.data()), m.body.size()};
+                msgs[i] = {};
+                msgs[i].msg_hdr.msg_name = &m.addr;
+                msgs[i].msg_hdr.msg_namelen = sizeof(m.addr);
+                msgs[i].msg_hdr.msg_iov = iov[i];
+                msgs[i].msg_hdr.msg_iovlen = m.body.empty() ? 1 : 2;
+            }
+            int sent = sendmmsg(sockfd_, msgs, n, 0);
+            if (sent < 0) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    pollfd pfd{sockfd_, POLLOUT, 0};
+                    poll(&pfd, 1, 100);
+                    continue;
+                }
+                std::cerr << "❌ sendmmsg 失敗 → errno=" << strerror(errno)
+                          << "\n";
+                sent = 1; // 丟棄這個封包，交給重傳機制
+            }
+            done += sent;
+        }
+        outq_.clear();
+    }
+
+protected:
+    void fill(int timeout_ms) override
+    {
+        if (drain() > 0)
+            return;
+        epoll_event ev;
+        if (epoll_wait(epfd_, &ev, 1, timeout_ms) > 0)
+            drain();
+    }
+
+private:
+    size_t drain()
+    {
+        size_t total = 0;
+        while (true) {
+            mmsghdr msgs[kBatch];
+            iovec iov[kBatch];
+            sockaddr_in addrs[kBatch];
+            for (size_t i = 0; i < kBatch; ++i) {
+                iov[i] = {bufs_[i], kMaxDatagram};
+                msgs[i] = {};
+                msgs[i].msg_hdr.msg_name = &addrs[i];
+                msgs[i].msg_hdr.msg_namelen = sizeof(addrs[i]);
+                msgs[i].msg_hdr.msg_iov = &iov[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+            int n = recvmmsg(sockfd_, msgs, kBatch, MSG_DONTWAIT, nullptr);
+            if (n <= 0)
+                return total;
+            for (int i = 0; i < n; ++i) {
+                if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+                    dropTruncated(addrs[i]);
+                else
+                    pending_.push_back(
+                        {addrs[i], std::string(bufs_[i], msgs[i].msg_len)});
+            }
+            total += n;
+            if (static_cast<size_t>(n) < kBatch)
+                return total;
+        }
+    }
+
+    struct OutMsg {
+        sockaddr_in addr;
+        std::string head;
+        std::string_view body;
+        std::shared_ptr<const void> owner;
+    };
+
+    int epfd_;
+    std::vector<OutMsg> outq_;
+    char bufs_[kBatch][kMaxDatagram];
+};
+
+// ---------------------------------------------------------------------------
+// io_uring：multishot recvmsg 收進 provided buffer ring，
+// sendmsg 與檔案 read 都送到同一個 ring 上
+// ---------------------------------------------------------------------------
+class UringBackend : public IoBackend
+{
+public:
+    explicit UringBackend(int sockfd) : IoBackend(sockfd) {}
+
+    ~UringBackend() override
+    {
+        if (ring_fd_ < 0)
+            return;
+        flush();
+        // 等所有送出與讀取完成，核心使用中的記憶體才能釋放
+        for (int i = 0; i < 50 && (in_flight_sends_ > 0 || !reads_.empty());
+             ++i)
+            reap(100);
+        if (buf_ring_)
+            munmap(buf_ring_, buf_ring_size_);
+        if (sqes_)
+            munmap(sqes_, sqes_size_);
+        if (cq_ptr_ && cq_ptr_ != sq_ptr_)
+            munmap(cq_ptr_, cq_size_);
+        if (sq_ptr_)
+            munmap(sq_ptr_, sq_size_);
+        close(ring_fd_);
+    }
+
+    // 核心不支援（io_uring 被停用、缺 PBUF_RING 或 multishot recvmsg）時回傳 false
+    bool init()
+    {
+        io_uring_params p{};
+        ring_fd_ = syscall(__NR_io_uring_setup, kEntries, &p);
+        if (ring_fd_ < 0)
+            return false;
+        if (!(p.features & IORING_FEAT_EXT_ARG) ||
+            !(p.features & IORING_FEAT_SINGLE_MMAP))
+            return false;
+
+        sq_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+        sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+        if (sq_ptr_ == MAP_FAILED) {
+            sq_ptr_ = nullptr;
+            return false;
+        }
+        cq_ptr_ = sq_ptr_;
+        sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe *>(
+            mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+        if (sqes_ == MAP_FAILED) {
+            sqes_ = nullptr;
+            return false;
+        }
+
+        char *sq = static_cast<char *>(sq_ptr_);
+        sq_head_ = reinterpret_cast<unsigned *>(sq + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<unsigned *>(sq + p.sq_off.tail);
+        sq_mask_ = *reinterpret_cast<unsigned *>(sq + p.sq_off.ring_mask);
+        sq_entries_ = p.sq_entries;
+        sq_array_ = reinterpret_cast<unsigned *>(sq + p.sq_off.array);
+        char *cq = static_cast<char *>(cq_ptr_);
+        cq_head_ = reinterpret_cast<unsigned *>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<unsigned *>(cq + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<unsigned *>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe *>(cq + p.cq_off.cqes);
+
+        if (!setupBufferRing())
+            return false;
+
+        armRecv();
+        // multishot recvmsg 不支援時核心會立刻回傳 -EINVAL
+        if (enter(0, 0) < 0)
+            return false;
+        reap(0);
+        return !recv_broken_;
+    }
+
+    const char *name() const override { return "io_uring"; }
+
+    void queueSend(const sockaddr_in &to, std::string data) override
+    {
+        queueSendChunk(to, std::move(data), {}, nullptr);
+    }
+
+    void queueSendChunk(const sockaddr_in &to,
+                        std::string header,
+                        std::string_view payload,
+                        std::shared_ptr<const void> owner) override
+    {
+        // SendOp 重複使用，不必每個 datagram 都配置記憶體
+        std::unique_ptr<SendOp> op;
+        if (free_sends_.empty()) {
+            op = std::make_unique<SendOp>();
+        } else {
+            op = std::move(free_sends_.back());
+            free_sends_.pop_back();
+        }
+        op->addr = to;
+        op->data = std::move(header);
+        op->owner = std::move(owner);
+        op->iov[0] = {op->data.data(), op->data.size()};
+        op->iov[1] = {const_cast<char *>(payload.data()), payload.size()};
+        op->msg.msg_name = &op->addr;
+        op->msg.msg_namelen = sizeof(op->addr);
+        op->msg.msg_iov = op->iov;
+        op->msg.msg_iovlen = payload.empty() ? 1 : 2;
+
+        io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = sockfd_;
+        sqe->addr = reinterpret_cast<uint64_t>(&op->msg);
+        sqe->len = 1;
+        sqe->user_data = kSendTag | reinterpret_cast<uint64_t>(op.get());
+        op.release();
+        ++in_flight_sends_;
+        ++unsubmitted_;
+    }
+
+    void flush() override
+    {
+        if (unsubmitted_ == 0)
+            return;
+        enter(unsubmitted_, 0);
+        unsubmitted_ = 0;
+        reap(0);
+    }
+
+    // 讀取送到 ring 上就返回，完成事件在 reap() 中與收到的封包一起處理
+    void readFile(const std::string &path, ReadDone done) override
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+            if (fd >= 0)
+                close(fd);
+            finished_reads_.push_back({std::move(done), false, {}});
+            return;
+        }
+        auto op = std::make_unique<ReadOp>();
+        op->fd = fd;
+        op->data.resize(st.st_size);
+        op->done = std::move(done);
+        submitRead(*op);
+        reads_.push_back(std::move(op));
+    }
+
+protected:
+    // 完成佇列裡可能只有送出完成，持續等到收到 datagram 或逾時為止
+    void fill(int timeout_ms) override
+    {
+        auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(timeout_ms);
+        while (!reap(timeout_ms) && timeout_ms != 0) {
+            if (timeout_ms < 0)
+                continue;
+            timeout_ms = std::max<int64_t>(
+                0, std::chrono::duration_cast<std::chrono::milliseconds>(
+                       deadline - std::chrono::steady_clock::now())
+                       .count());
+        }
+    }
+
+private:
+    static constexpr unsigned kEntries = 256;
+    static constexpr unsigned kBufCount = 256; // 必須是 2 的次方
+    // multishot recvmsg 把 io_uring_recvmsg_out 表頭與來源位址放在 payload
+    // 前面，buffer 必須再多出這些空間才能收下 kMaxDatagram 的 datagram
+    static constexpr size_t kRecvBufSize =
+        sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_in) + kMaxDatagram;
+    static constexpr uint16_t kBufGroup = 0;
+    static constexpr uint64_t kRecvTag = 1ULL << 62;
+    static constexpr uint64_t kSendTag = 2ULL << 62;
+    static constexpr uint64_t kReadTag = 3ULL << 62;
+    static constexpr uint64_t kTagMask = 3ULL << 62;
+
+    struct SendOp {
+        sockaddr_in addr;
+        std::string data;
+        std::shared_ptr<const void> owner;
+        iovec iov[2];
+        msghdr msg{};
+    };
+
+    // 一個檔案的讀取；短讀時從 offset 繼續送出下一個 read
+    struct ReadOp {
+        int fd = -1;
+        std::string data;
+        size_t offset = 0;
+        ReadDone done;
+    };
+
+    bool setupBufferRing()
+    {
+        buf_ring_size_ = kBufCount * sizeof(io_uring_buf);
+        buf_ring_ = static_cast<io_uring_buf *>(
+            mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE,
+                 MAP_ANONYMOUS | MAP_PRIVATE, -1, 0));
+        if (buf_ring_ == MAP_FAILED) {
+            buf_ring_ = nullptr;
+            return false;
+        }
+
+        io_uring_buf_reg reg{};
+        reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring_);
+        reg.ring_entries = kBufCount;
+        reg.bgid = kBufGroup;
+        if (syscall(__NR_io_uring_register, ring_fd_,
+                    IORING_REGISTER_PBUF_RING, &reg, 1) < 0)
+            return false;
+
+        buffers_.resize(kBufCount * kRecvBufSize);
+        for (unsigned i = 0; i < kBufCount; ++i)
+            recycleBuffer(i);
+        return true;
+    }
+
+    // ring 的 tail 疊在第 0 個 entry 的 resv 欄位上。
+    // 不使用 io_uring_buf_ring::bufs：C++ 下其 flex array 位移是 8 而非 0
+    void recycleBuffer(uint16_t bid)
+    {
+        __u16 *tail_ptr = &buf_ring_[0].resv;
+        __u16 tail = *tail_ptr;
+        io_uring_buf &b = buf_ring_[tail & (kBufCount - 1)];
+        b.addr = reinterpret_cast<uint64_t>(&buffers_[bid * kRecvBufSize]);
+        b.len = kRecvBufSize;
+        b.bid = bid;
+        __atomic_store_n(tail_ptr, static_cast<__u16>(tail + 1),
+                         __ATOMIC_RELEASE);
+    }
+
+    void armRecv()
+    {
+        recv_msg_ = {};
+        recv_msg_.msg_namelen = sizeof(sockaddr_in);
+        io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_RECVMSG;
+        sqe->fd = sockfd_;
+        sqe->addr = reinterpret_cast<uint64_t>(&recv_msg_);
+        sqe->ioprio = IORING_RECV_MULTISHOT;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = kBufGroup;
+        sqe->user_data = kRecvTag;
+        ++unsubmitted_;
+    }
+
+    void submitRead(ReadOp &op)
+    {
+        io_uring_sqe *sqe = getSqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = op.fd;
+        sqe->off = op.offset;
+        sqe->addr = reinterpret_cast<uint64_t>(op.data.data() + op.offset);
+        sqe->len = op.data.size() - op.offset;
+        sqe->user_data = kReadTag | reinterpret_cast<uint64_t>(&op);
+        ++unsubmitted_;
+    }
+
+    // 讀取結束（完成或失敗）：關閉檔案，結果交給 completeReads()
+    void finishRead(ReadOp *op, bool ok)
+    {
+        close(op->fd);
+        auto it = std::find_if(reads_.begin(), reads_.end(),
+                               [op](const auto &r) { return r.get() == op; });
+        op->data.resize(op->offset);
+        finished_reads_.push_back({std::move(op->done), ok,
+                                   std::move(op->data)});
+        reads_.erase(it);
+    }
+
+    io_uring_sqe *getSqe()
+    {
+        unsigned tail = *sq_tail_;
+        if (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+            enter(unsubmitted_, 0);
+            unsubmitted_ = 0;
+            while (tail - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >=
+                   sq_entries_)
+                reap(0);
+        }
+        unsigned idx = tail & sq_mask_;
+        io_uring_sqe *sqe = &sqes_[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[idx] = idx;
+        __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+        return sqe;
+    }
+
+    int enter(unsigned to_submit, unsigned min_complete, int timeout_ms = -1)
+    {
+        unsigned flags = IORING_ENTER_EXT_ARG;
+        if (min_complete)
+            flags |= IORING_ENTER_GETEVENTS;
+        __kernel_timespec ts{timeout_ms / 1000,
+                             (timeout_ms % 1000) * 1000000LL};
+        io_uring_getevents_arg arg{};
+        if (timeout_ms >= 0)
+            arg.ts = reinterpret_cast<uint64_t>(&ts);
+        return syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete,
+                       flags, &arg, sizeof(arg));
+    }
+
+    // 處理完成佇列；若 CQ 為空則最多等 timeout_ms。
+    // 有新的 datagram 或有檔案讀完時回傳 true。
+    bool reap(int timeout_ms)
+    {
+        size_t before = pending_.size();
+        size_t reads_before = finished_reads_.size();
+        unsigned head = *cq_head_;
+        if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE) &&
+            timeout_ms != 0) {
+            int r = enter(unsubmitted_, 1, timeout_ms);
+            unsubmitted_ = 0;
+            if (r < 0 && errno != ETIME && errno != EINTR)
+                std::cerr << "❌ io_uring_enter 失敗 → errno="
+                          << strerror(errno) << "\n";
+        }
+
+        bool rearm = false;
+        // 短讀的檔案等 CQ 的 head 更新後再送出，getSqe() 可能會呼叫 reap()
+        std::vector<ReadOp *> short_reads;
+        unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const io_uring_cqe &cqe = cqes_[head & cq_mask_];
+            uint64_t tag = cqe.user_data & kTagMask;
+            if (tag == kRecvTag) {
+                if (!(cqe.flags & IORING_CQE_F_MORE))
+                    rearm = true;
+                if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP) {
+                    recv_broken_ = true;
+                    rearm = false;
+                }
+                if (cqe.flags & IORING_CQE_F_BUFFER) {
+                    uint16_t bid = cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+                    if (cqe.res > 0)
+                        parseRecv(&buffers_[bid * kRecvBufSize], cqe.res);
+                    recycleBuffer(bid);
+                }
+            } else if (tag == kSendTag) {
+                std::unique_ptr<SendOp> op(
+                    reinterpret_cast<SendOp *>(cqe.user_data & ~kTagMask));
+                op->owner.reset();
+                --in_flight_sends_;
+                if (free_sends_.size() < kEntries)
+                    free_sends_.push_back(std::move(op));
+            } else if (tag == kReadTag) {
+                auto *op = reinterpret_cast<ReadOp *>(cqe.user_data & ~kTagMask);
+                if (cqe.res > 0)
+                    op->offset += cqe.res;
+                if (cqe.res > 0 && op->offset < op->data.size())
+                    short_reads.push_back(op);
+                else
+                    finishRead(op, cqe.res >= 0 &&
+                                       op->offset == op->data.size());
+            }
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+        if (rearm)
+            armRecv();
+        for (ReadOp *op : short_reads)
+            submitRead(*op);
+        return pending_.size() > before ||
+               finished_reads_.size() > reads_before;
+    }
+
+    void parseRecv(char *buf, int len)
+    {
+        io_uring_recvmsg_out out;
+        std::memcpy(&out, buf, sizeof(out));
+        Datagram d{};
+        std::memcpy(&d.addr, buf + sizeof(out),
+                    std::min<size_t>(out.namelen, sizeof(d.addr)));
+        if (out.flags & MSG_TRUNC) {
+            dropTruncated(d.addr);
+            return;
+        }
+        const char *payload = buf + sizeof(out) + recv_msg_.msg_namelen +
+                              recv_msg_.msg_controllen;
+        d.data.assign(payload, out.payloadlen);
+        pending_.push_back(std::move(d));
+    }
+
+    int ring_fd_ = -1;
+    void *sq_ptr_ = nullptr;
+    void *cq_ptr_ = nullptr;
+    size_t sq_size_ = 0;
+    size_t cq_size_ = 0;
+    io_uring_sqe *sqes_ = nullptr;
+    size_t sqes_size_ = 0;
+    unsigned *sq_head_ = nullptr;
+    unsigned *sq_tail_ = nullptr;
+    unsigned *sq_array_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned sq_entries_ = 0;
+    unsigned *cq_head_ = nullptr;
+    unsigned *cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe *cqes_ = nullptr;
+    unsigned unsubmitted_ = 0;
+
+    io_uring_buf *buf_ring_ = nullptr;
+    size_t buf_ring_size_ = 0;
+    std::vector<char> buffers_;
+    msghdr recv_msg_{};
+    bool recv_broken_ = false;
+
+    std::vector<std::unique_ptr<ReadOp>> reads_;
+    // 送出中的 SendOp 由 user_data 指向，完成時收回 free_sends_
+    size_t in_flight_sends_ = 0;
+    std::vector<std::unique_ptr<SendOp>> free_sends_;
+};
+
+std::unique_ptr<IoBackend> makeIoBackend(int sockfd, const std::string &name)
+{
+    if (name == "socket")
+        return std::make_unique<SocketBackend>(sockfd);
+
+    // auto 選 epoll：loopback 上 recvmmsg / sendmmsg 的每封包成本不比 io_uring 高，
+    // io_uring 需要明確指定
+    if (name == "io_uring") {
+        auto uring = std::make_unique<UringBackend>(sockfd);
+        if (uring->init())
+            return uring;
+        std::cerr << "⚠️ 核心不支援 io_uring multishot recv，改用 epoll\n";
+    } else if (name != "epoll" && name != "auto") {
+        std::cerr << "⚠️ 未知的 I/O 後端：" << name << "，改用 epoll\n";
+    }
+    return std::make_unique<EpollBackend>(sockfd);
+}
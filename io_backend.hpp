@@ -0,0 +1,75 @@
+#pragma once
+#include <netinet/in.h>
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+
+// 一個收到（或待送出）的 UDP datagram
+struct Datagram {
+    sockaddr_in addr;
+    std::string data;
+};
+
+// I/O 後端：封裝 socket 的收送與 FILE_REQ 的檔案讀取。
+// receive() 一次只交出一個 datagram，但後端內部可以批次收取；
+// queueSend() 只把封包排入佇列，直到 flush()（或下一次 receive()）才真正送出。
+class IoBackend
+{
+public:
+    explicit IoBackend(int sockfd) : sockfd_(sockfd) {}
+    virtual ~IoBackend() = default;
+
+    virtual const char *name() const = 0;
+
+    // 最多等待 timeout_ms 毫秒（-1 表示無限等待）
+    bool receive(Datagram &out, int timeout_ms);
+
+    virtual void queueSend(const sockaddr_in &to, std::string data) = 0;
+    // 零拷貝送出：header 與 payload 以兩段 iovec 送出，payload 不複製；
+    // owner 保證 payload 在真正送出前仍然有效
+    virtual void queueSendChunk(const sockaddr_in &to,
+                                std::string header,
+                                std::string_view payload,
+                                std::shared_ptr<const void> owner);
+    virtual void flush() = 0;
+
+    // 讀取 ./files 底下的整個檔案，不阻塞主迴圈：讀完後在下一次
+    // completeReads() 時以結果呼叫 done（開檔或讀取失敗時 ok 為 false）
+    using ReadDone = std::function<void(bool ok, std::string data)>;
+    virtual void readFile(const std::string &path, ReadDone done);
+    // 執行已完成讀取的 callback，回傳執行的數量
+    size_t completeReads();
+    bool readsReady() const { return !finished_reads_.empty(); }
+
+    int fd() const { return sockfd_; }
+    // 超過 kMaxDatagram 而被截斷、丟棄的 datagram 數
+    uint64_t truncated() const { return truncated_; }
+
+    // 可以完整收下的最大 datagram，更大的會被截斷而丟棄
+    static constexpr size_t kMaxDatagram = 4096;
+
+protected:
+    // 把收到的 datagram 放進 pending_；逾時則不放任何東西
+    virtual void fill(int timeout_ms) = 0;
+    // 截斷的 datagram 內容不完整，記錄後丟棄
+    void dropTruncated(const sockaddr_in &from);
+
+    struct FinishedRead {
+        ReadDone done;
+        bool ok;
+        std::string data;
+    };
+
+    int sockfd_;
+    std::deque<Datagram> pending_;
+    std::deque<FinishedRead> finished_reads_;
+    uint64_t truncated_ = 0;
+};
+
+// 依名稱建立後端："socket"、"epoll"、"io_uring" 或 "auto"（即 epoll）。
+// "io_uring" 在核心不支援時會退回 epoll。
+std::unique_ptr<IoBackend> makeIoBackend(int sockfd, const std::string &name);
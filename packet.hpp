@@ -1,7 +1,10 @@
 #pragma once
+#include <algorithm>
 #include <cstdint>
 #include <sstream>
 #include <string>
+#include <utility>
+#include <vector>
 
 enum class PacketType {
     SYN,
@@ -13,13 +16,19 @@ enum class PacketType {
     FILE_END,
     EXPR_REQ,
     EXPR_RES,
-    DATA_ACK
+    DATA_ACK,
+    FANOUT_REQ,
+    FANOUT_INFO,
+    FANOUT_DATA,
+    FANOUT_FLUSH,
+    FANOUT_NAK,
+    RST
 };
 
 static PacketType parsePacketType(int value)
 {
     if (value < static_cast<int>(PacketType::SYN) ||
-        value > static_cast<int>(PacketType::DATA_ACK)) {
+        value > static_cast<int>(PacketType::RST)) {
         throw std::invalid_argument("Invalid PacketType value");
     }
     return static_cast<PacketType>(value);
@@ -32,14 +41,17 @@ struct Packet {
     PacketType type;
     std::string payload;
 
-    std::string serialize() const
+    // 不含 payload 的表頭；零拷貝送出時 payload 另外以 iovec 接在後面
+    std::string serializeHeader() const
     {
         std::ostringstream oss;
         oss << static_cast<int>(type) << "|" << seq << "|" << ack << "|"
-            << window << "|" << payload;
+            << window << "|";
         return oss.str();
     }
 
+    std::string serialize() const { return serializeHeader() + payload; }
+
     static Packet deserialize(const std::string &raw)
     {
         std::istringstream iss(raw);
@@ -50,10 +62,10 @@ struct Packet {
         pkt.type = parsePacketType(std::stoi(token));
 
         std::getline(iss, token, '|');
-        pkt.seq = std::stoi(token);
+        pkt.seq = std::stoul(token);
 
         std::getline(iss, token, '|');
-        pkt.ack = std::stoi(token);
+        pkt.ack = std::stoul(token);
 
         std::getline(iss, token, '|');
         pkt.window = std::stoi(token);
@@ -87,7 +99,122 @@ inline std::string to_string(PacketType type)
         return "EXPR_RES";
     case PacketType::DATA_ACK:
         return "DATA_ACK";
+    case PacketType::FANOUT_REQ:
+        return "FANOUT_REQ";
+    case PacketType::FANOUT_INFO:
+        return "FANOUT_INFO";
+    case PacketType::FANOUT_DATA:
+        return "FANOUT_DATA";
+    case PacketType::FANOUT_FLUSH:
+        return "FANOUT_FLUSH";
+    case PacketType::FANOUT_NAK:
+        return "FANOUT_NAK";
+    case PacketType::RST:
+        return "RST";
     default:
         return "UNKNOWN";
     }
 }
+
+// RST：server 不認得送請求的 client（連線已被淘汰且 cookie 已過期）時回覆，
+// ack = 該請求的 seq；client 收到後重新握手再重送請求
+
+// 0-RTT：把第一個 EXPR_REQ / FILE_REQ 附在 SYN 的 payload 上，
+// 格式為 "<PacketType>|<原本的 payload>"；一般 SYN 的 payload 為 "client"
+inline std::string makeEarlyData(PacketType type, const std::string &payload)
+{
+    return std::to_string(static_cast<int>(type)) + "|" + payload;
+}
+
+inline bool parseEarlyData(const std::string &syn_payload,
+                           PacketType &type,
+                           std::string &payload)
+{
+    size_t sep = syn_payload.find('|');
+    if (sep == std::string::npos || sep == 0)
+        return false;
+    try {
+        type = parsePacketType(std::stoi(syn_payload.substr(0, sep)));
+    } catch (const std::exception &) {
+        return false;
+    }
+    if (type != PacketType::EXPR_REQ && type != PacketType::FILE_REQ)
+        return false;
+    payload = syn_payload.substr(sep + 1);
+    return true;
+}
+
+// Window scale（類似 TCP 的 RFC 7323 選項）：SYN / SYN_ACK 的 payload 以
+// "wscale=<n>;" 開頭。雙方都帶了這個選項才啟用，之後 client 通告的 window
+// 欄位一律代表 window << n 個封包；未協商時 n 為 0。
+constexpr uint8_t kMaxWindowScale = 14;
+
+inline std::string withWindowScale(uint8_t wscale, const std::string &payload)
+{
+    return "wscale=" + std::to_string(wscale) + ";" + payload;
+}
+
+// 從 payload 移除 window scale 選項；有帶選項時回傳 true
+inline bool stripWindowScale(std::string &payload, uint8_t &wscale)
+{
+    static const std::string prefix = "wscale=";
+    size_t end = payload.find(';');
+    if (payload.rfind(prefix, 0) != 0 || end == std::string::npos)
+        return false;
+    try {
+        unsigned long n =
+            std::stoul(payload.substr(prefix.size(), end - prefix.size()));
+        wscale = std::min<unsigned long>(n, kMaxWindowScale);
+    } catch (const std::exception &) {
+        return false;
+    }
+    payload.erase(0, end + 1);
+    return true;
+}
+
+// Fan-out 傳輸：同一個檔案一次送給一群 client，接收端只回報缺少的部分（NAK）。
+//   FANOUT_REQ   client → server：payload 為檔名
+//   FANOUT_INFO  server → client：seq = session id，ack = 請求的 seq，
+//                payload 為 "<chunk 數>|<multicast ip:port，未啟用時為空>"
+//   FANOUT_DATA  server → 群組：seq = chunk 索引，ack = session id
+//   FANOUT_FLUSH server → client：seq = 輪次，ack = session id，要求回報缺漏
+//   FANOUT_NAK   client → server：seq = 輪次，ack = session id，payload 為
+//                缺少的 chunk 範圍 "a-b,c,..."；空字串表示已經收齊，
+//                kNakUnknownSession 表示接收端不認得這個 session
+inline constexpr char kNakUnknownSession[] = "?";
+
+using ChunkRange = std::pair<uint32_t, uint32_t>; // [first, last]
+
+inline std::string formatRanges(const std::vector<ChunkRange> &ranges)
+{
+    std::string out;
+    for (const auto &[first, last] : ranges) {
+        if (!out.empty())
+            out.push_back(',');
+        out += std::to_string(first);
+        if (last != first)
+            out += "-" + std::to_string(last);
+    }
+    return out;
+}
+
+// 無法解析的部分直接略過
+inline std::vector<ChunkRange> parseRanges(const std::string &payload)
+{
+    std::vector<ChunkRange> ranges;
+    std::istringstream iss(payload);
+    std::string item;
+    while (std::getline(iss, item, ',')) {
+        try {
+            size_t dash = item.find('-');
+            uint32_t first = std::stoul(item.substr(0, dash));
+            uint32_t last = dash == std::string::npos
+                                ? first
+                                : std::stoul(item.substr(dash + 1));
+            if (first <= last)
+                ranges.emplace_back(first, last);
+        } catch (const std::exception &) {
+        }
+    }
+    return ranges;
+}
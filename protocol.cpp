@@ -5,13 +5,13 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <unistd.h>
+#include <algorithm>
 #include <cerrno>
 #include <cstring>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <stdexcept>
-#include <unordered_set>
 
 
 class ExpressionParser
@@ -78,34 +78,73 @@ private:
 };
 
 Packet Protocol::handleHandshake(const Packet &pkt,
-                                 ConnectionState &state,
+                                 const sockaddr_in &client_addr,
                                  const std::string &client_key)
 {
+    // client 有帶 window scale 選項時記進 cookie，並在 SYN_ACK 回帶選項表示同意
+    std::string options = pkt.payload;
+    uint8_t wscale = 0;
+    bool scaled = stripWindowScale(options, wscale);
+
     Packet syn_ack;
-    syn_ack.seq = 200;
+    syn_ack.seq = cookies_.make(client_addr, pkt.window, wscale);
     syn_ack.ack = pkt.seq;
-    syn_ack.window = state.window_size;
+    syn_ack.window = 1024;
     syn_ack.type = PacketType::SYN_ACK;
 
     // 使用 client_key 的 port 作為 payload
     std::string port = client_key.substr(client_key.find(':') + 1);
     syn_ack.payload = "client:" + port;
+    if (scaled)
+        syn_ack.payload = withWindowScale(0, syn_ack.payload);
 
     return syn_ack;
 }
 
+bool Protocol::acceptHandshake(const Packet &pkt,
+                               const sockaddr_in &client_addr,
+                               ConnectionState &state)
+{
+    // 只有握手的 ACK 與 client 的請求會攜帶 cookie
+    if (pkt.type != PacketType::ACK && pkt.type != PacketType::SYN &&
+        pkt.type != PacketType::EXPR_REQ && pkt.type != PacketType::FILE_REQ &&
+        pkt.type != PacketType::FANOUT_REQ)
+        return false;
+
+    uint32_t cookie = pkt.ack - 1;
+    uint16_t window;
+    uint8_t wscale;
+    if (!cookies_.check(client_addr, cookie, window, wscale))
+        return false;
+
+    state = ConnectionState{pkt.seq, cookie + 1, 1024, true,
+                            std::chrono::steady_clock::now()};
+    state.peer_window_scale = wscale;
+    // SYN 上的視窗不套用 scale（與 TCP 相同），之後的封包才以 scale 解讀
+    if (pkt.type == PacketType::SYN)
+        state.peer_window = window;
+    else
+        state.updatePeerWindow(pkt.window);
+    return true;
+}
+
 Packet Protocol::handleExpression(const std::string &expr,
                                   ConnectionState &state)
 {
-    ExpressionParser parser(expr);
-    double result = parser.parse();
-
     Packet response;
     response.seq = state.server_seq++;
     response.ack = state.client_seq;
     response.window = state.window_size;
     response.type = PacketType::EXPR_RES;
-    response.payload = std::to_string(result);
+
+    // 算式來自未經驗證的封包（0-RTT 時甚至還沒握手），解析失敗只回報錯誤
+    try {
+        ExpressionParser parser(expr);
+        response.payload = std::to_string(parser.parse());
+    } catch (const std::exception &) {
+        std::cout << "⚠️ 無法解析的運算式：" << expr << "\n";
+        response.payload = "Invalid expression";
+    }
     return response;
 }
 
@@ -160,225 +199,179 @@ Packet Protocol::makeErrorPacket(ConnectionState &state, const std::string &msg)
     return p;
 }
 
-Packet Protocol::makeDataPacket(ConnectionState &state,
-                                const std::string &payload)
-{
-    Packet p;
-    p.seq = state.server_seq++;
-    p.ack = state.client_seq;
-    p.window = state.window_size;
-    p.type = PacketType::FILE_DATA;
-    p.payload = payload;
-    return p;
-}
-
-Packet Protocol::makeEOFPacket(ConnectionState &state)
+// 封包只排入排程器，下一次 poll() 時才依優先順序交給 I/O 後端
+void Protocol::sendReply(const Packet &pkt, const sockaddr_in &client_addr)
 {
-    Packet p;
-    p.seq = state.server_seq++;
-    p.ack = state.client_seq;
-    p.window = state.window_size;
-    p.type = PacketType::FILE_END;
-    p.payload = "";
-    return p;
+    scheduler_.pushPriority(client_addr, pkt);
 }
 
-void Protocol::sendPacket(int sockfd,
-                          const Packet &pkt,
-                          const sockaddr_in &client_addr)
+void Protocol::startFileTransfer(const std::string &filename,
+                                 ConnectionState &state,
+                                 const std::string &client_key,
+                                 const sockaddr_in &client_addr)
 {
-    std::string raw = pkt.serialize();
-    ssize_t n = sendto(sockfd, raw.c_str(), raw.size(), 0,
-                       (sockaddr *) &client_addr, sizeof(client_addr));
-
-    char ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &(client_addr.sin_addr), ip, INET_ADDRSTRLEN);
-    uint16_t port = ntohs(client_addr.sin_port);
-
-    if (n >= 0 && static_cast<size_t>(n) == raw.size()) {
-        std::cout << "📤 sendPacket 成功 → " << ip << ":" << port
-                  << " type=" << to_string(pkt.type)
-                  << " seq=" << pkt.seq << " ack=" << pkt.ack
-                  << " size=" << raw.size() << "\n";
-    } else {
-        std::cerr << "❌ sendPacket 失敗 → " << ip << ":" << port
-                  << " type=" << to_string(pkt.type)
-                  << " seq=" << pkt.seq << " ack=" << pkt.ack
-                  << " errno=" << strerror(errno)
-                  << " size=" << raw.size() << "\n";
-    }
-}
-
-bool Protocol::receivePacket(int sockfd, Packet &pkt, sockaddr_in *sender) {
-    char buffer[4096];
-    sockaddr_in from_addr;
-    socklen_t len = sizeof(from_addr);
-
-    ssize_t n = recvfrom(sockfd, buffer, sizeof(buffer), 0,
-                         (sockaddr *) &from_addr, &len);
-
-    if (n <= 0) {
-        std::cerr << "⚠️ receivePacket 失敗或 timeout → errno=" << strerror(errno) << "\n";
-        return false;
-    }
-
-    pkt = Packet::deserialize(std::string(buffer, n));
-
-    char ip[INET_ADDRSTRLEN];
-    inet_ntop(AF_INET, &(from_addr.sin_addr), ip, INET_ADDRSTRLEN);
-    uint16_t port = ntohs(from_addr.sin_port);
-
-    std::cout << "📥 receivePacket 成功 ← " << ip << ":" << port
-              << " type=" << to_string(pkt.type)
-              << " seq=" << pkt.seq << " ack=" << pkt.ack
-              << " size=" << n << "\n";
-
-    if (sender) {
-        *sender = from_addr;
+    // client 等不到回應時會重送同一個 FILE_REQ，進行中（或還在讀檔）的傳輸
+    // 不重新開始
+    auto it = transfers_.find(client_key);
+    bool running = it != transfers_.end() &&
+                   std::any_of(it->second.begin(), it->second.end(),
+                               [&](const auto &t) {
+                                   return t->requestSeq() == state.client_seq;
+                               });
+    if (running || !loading_.emplace(client_key, state.client_seq).second) {
+        std::cout << "⏭️ 重複的 FILE_REQ seq=" << state.client_seq
+                  << "，傳輸進行中\n";
+        return;
     }
 
-    return true;
+    // 從 content cache 取得已切好的封包；未命中時經由 I/O 後端讀檔，
+    // 讀完才開始傳送，主迴圈不必等待。連線狀態可能在讀檔期間被淘汰，保留一份
+    ConnectionState snapshot = state;
+    cache_.get("./files/" + filename, io_,
+               [this, client_key, client_addr, snapshot](
+                   CachedFilePtr file) mutable {
+                   loading_.erase({client_key, snapshot.client_seq});
+                   if (!file) {
+                       sendReply(makeErrorPacket(snapshot, "File not found"),
+                                 client_addr);
+                       return;
+                   }
+                   auto &active = transfers_[client_key];
+                   active.push_back(std::make_unique<FileTransfer>(
+                       client_key, client_addr, std::move(file), snapshot,
+                       scheduler_, tracer_));
+                   active.back()->start(Clock::now());
+               });
 }
 
-std::vector<Packet> Protocol::collectAckPackets(int sockfd, size_t expected_ack_count) {
-    std::vector<Packet> acks;
-    int max_attempts = 5;
-    for (int i = 0; i < max_attempts; ++i) {
-        Packet p;
-        if (receivePacket(sockfd, p) && p.type == PacketType::DATA_ACK) {
-            acks.push_back(p);
+void Protocol::handleDataAck(const std::string &client_key, const Packet &ack)
+{
+    auto it = transfers_.find(client_key);
+    if (it == transfers_.end())
+        return;
+    for (const auto &transfer : it->second) {
+        if (transfer->owns(ack)) {
+            transfer->onAck(ack, Clock::now());
+            return;
         }
-        if (acks.size() >= expected_ack_count) break;
-        usleep(100000); // 100ms
     }
-    return acks;
 }
 
-void Protocol::sendFileWithCongestionControl(const std::string &filename,
-                                             ConnectionState &state,
-                                             int sockfd,
-                                             const sockaddr_in &client_addr)
+void Protocol::joinFanout(const std::string &filename,
+                          ConnectionState &state,
+                          const std::string &client_key,
+                          const sockaddr_in &client_addr)
 {
-    std::ifstream file("./files/" + filename);
-    if (!file.is_open()) {
-        Packet error = makeErrorPacket(state, "File not found");
-        sendPacket(sockfd, error, client_addr);
+    // 重送的請求（沒收到 FANOUT_INFO）：只重送 FANOUT_INFO
+    for (const auto &[id, session] : fanouts_)
+        if (session->rejoin(client_key, state.client_seq))
+            return;
+    if (FanoutSession *session = gatheringSession(filename)) {
+        session->join(client_key, client_addr, state.client_seq);
         return;
     }
 
-    struct timeval tv = {5, 0};
-    setsockopt(sockfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-
-    size_t cwnd = 1;
-    size_t ssthresh = 64;
-    size_t flow_window = state.window_size;
-    size_t duplicate_ack_count = 0;
-    uint32_t last_ack_seq = 0;
-    bool in_fast_recovery = false;
-
-    std::string line;
-    bool eof_reached = false;
-    std::vector<Packet> inFlight;
-    std::unordered_set<uint32_t> acked_seqs;
-
-    while (!eof_reached) {
-        size_t send_limit = std::min(cwnd, flow_window);
-        size_t sent = 0;
-
-        while (sent < send_limit) {
-            if (!std::getline(file, line)) {
-                eof_reached = true;
-                break;
+    // 讀檔期間同一個檔案的其他請求會等同一次讀取，讀完時再合併到同一個 session
+    ConnectionState snapshot = state;
+    cache_.get(
+        "./files/" + filename, io_,
+        [this, filename, client_key, client_addr, snapshot](
+            CachedFilePtr file) mutable {
+            for (const auto &[id, session] : fanouts_)
+                if (session->rejoin(client_key, snapshot.client_seq))
+                    return;
+            FanoutSession *session = gatheringSession(filename);
+            if (!session && !file) {
+                sendReply(makeErrorPacket(snapshot, "File not found"),
+                          client_addr);
+                return;
             }
+            if (!session) {
+                uint32_t id = next_fanout_id_++;
+                session = (fanouts_[id] = std::make_unique<FanoutSession>(
+                               id, std::move(file), fanout_opts_, scheduler_,
+                               Clock::now()))
+                              .get();
+                gathering_[filename] = id;
+            }
+            session->join(client_key, client_addr, snapshot.client_seq);
+        });
+}
 
-            Packet p = makeDataPacket(state, line);
-            sendPacket(sockfd, p, client_addr);
-            std::cout << "📤 傳送封包 seq=" << p.seq << " cwnd=" << cwnd << "\n";
-            inFlight.push_back(p);
-            sent++;
-        }
+FanoutSession *Protocol::gatheringSession(const std::string &filename)
+{
+    auto it = gathering_.find(filename);
+    if (it == gathering_.end() || !fanouts_.at(it->second)->gathering())
+        return nullptr;
+    return fanouts_.at(it->second).get();
+}
 
-        std::vector<Packet> received_acks = collectAckPackets(sockfd, inFlight.size()); // ✅ 支援輪詢多次直到收滿 ACK
-        std::vector<Packet> unackedPackets;
-
-        for (Packet &p : inFlight) {
-            bool acked = false;
-
-            for (const Packet &ack : received_acks) {
-                if (ack.seq == p.seq + 1) {
-                    acked_seqs.insert(ack.seq);
-                    state.client_seq = ack.seq;
-                    std::cout << "✅ ACK received for seq=" << p.seq << "\n";
-                    acked = true;
-
-                    if (ack.seq == last_ack_seq) {
-                        duplicate_ack_count++;
-                        std::cout << "🔁 Duplicate ACK #" << duplicate_ack_count << "\n";
-                        if (duplicate_ack_count == 3 && !in_fast_recovery) {
-                            std::cout << "🚨 Fast Retransmit triggered for seq=" << p.seq << "\n";
-                            ssthresh = std::max(cwnd / 2, size_t(1));
-                            cwnd = ssthresh;
-                            in_fast_recovery = true;
-                            sendPacket(sockfd, p, client_addr);
-                        }
-                    } else {
-                        duplicate_ack_count = 0;
-                        last_ack_seq = ack.seq;
-                        cwnd = (cwnd < ssthresh) ? cwnd * 2 : cwnd + 1;
-                        std::cout << "📈 cwnd 成長為 " << cwnd << "（ssthresh=" << ssthresh << "）\n";
-                        if (in_fast_recovery) {
-                            std::cout << "🎯 Fast Recovery complete\n";
-                            in_fast_recovery = false;
-                        }
-                    }
-
-                    break;
-                }
-            }
+void Protocol::handleFanoutNak(const std::string &client_key, const Packet &nak)
+{
+    auto it = fanouts_.find(nak.ack);
+    if (it != fanouts_.end())
+        it->second->onNak(client_key, nak, Clock::now());
+}
 
-            if (!acked) {
-                if (acked_seqs.count(p.seq + 1) == 0) {
-                    std::cout << "⚠️ Timeout or loss for seq=" << p.seq << "\n";
-                    unackedPackets.push_back(p);
-
-                    ssthresh = std::max(cwnd / 2, size_t(1));
-                    cwnd = 1;
-                    std::cout << "📉 cwnd 退回至 1（ssthresh=" << ssthresh << "）\n";
-                    in_fast_recovery = false;
-                    duplicate_ack_count = 0;
-                } else {
-                    std::cout << "⏭️ 已 ACK，跳過重傳 seq=" << p.seq << "\n";
-                }
-            }
-        }
+size_t Protocol::poll(Clock::time_point now)
+{
+    // 讀完的檔案先開始傳送，這一輪就能排進排程器
+    io_.completeReads();
+
+    size_t finished = 0;
+    for (auto it = transfers_.begin(); it != transfers_.end();) {
+        std::vector<std::unique_ptr<FileTransfer>> &active = it->second;
+        for (const auto &transfer : active)
+            transfer->onTimer(now);
+        finished += std::erase_if(active,
+                                  [](const auto &t) { return t->done(); });
+        it = active.empty() ? transfers_.erase(it) : std::next(it);
+    }
 
-        for (Packet &p : unackedPackets) {
-            std::cout << "🔁 重傳未 ACK 封包 seq=" << p.seq << "\n";
-            sendPacket(sockfd, p, client_addr);
+    for (auto it = fanouts_.begin(); it != fanouts_.end();) {
+        it->second->poll(now);
+        if (!it->second->done()) {
+            ++it;
+            continue;
         }
-
-        inFlight.clear();
+        std::erase_if(gathering_, [id = it->first](const auto &g) {
+            return g.second == id;
+        });
+        it = fanouts_.erase(it);
+        ++finished;
     }
 
-    Packet eof = makeEOFPacket(state);
-    sendPacket(sockfd, eof, client_addr);
-    std::cout << "📤 傳送 FILE_END 給 client\n";
+    // 交給 I/O 後端後仍只是排入佇列，收完目前這批封包時才一起送出
+    scheduler_.dispatch(io_, now);
+    return finished;
+}
 
-    int attempts = 0;
-    while (attempts < 5) {
-        std::vector<Packet> acks = collectAckPackets(sockfd, 1); // 最多收 1 個 ACK
-        for (const Packet &ack : acks) {
-            if (ack.type == PacketType::DATA_ACK && ack.seq == eof.seq + 1) {
-                std::cout << "✅ FILE_END 被 ACK\n";
-                return;
-            }
+int Protocol::msUntilNextEvent(Clock::time_point now) const
+{
+    if (io_.readsReady())
+        return 0;
+    int wait = scheduler_.msUntilReady(now);
+    for (const auto &[key, active] : transfers_) {
+        for (const auto &transfer : active) {
+            auto left = std::chrono::ceil<std::chrono::milliseconds>(
+                transfer->deadline() - now);
+            int ms = std::max<int>(left.count(), 0);
+            wait = wait < 0 ? ms : std::min(wait, ms);
         }
-
-        std::cout << "🔁 重傳 FILE_END（第 " << attempts + 1 << " 次）\n";
-        sendPacket(sockfd, eof, client_addr);
-        attempts++;
     }
+    for (const auto &[id, session] : fanouts_) {
+        auto left = std::chrono::ceil<std::chrono::milliseconds>(
+            session->deadline() - now);
+        int ms = std::max<int>(left.count(), 0);
+        wait = wait < 0 ? ms : std::min(wait, ms);
+    }
+    return wait;
+}
 
-
-    std::cout << "❌ FILE_END 未被 ACK，傳輸可能不完整\n";
+size_t Protocol::activeTransfers() const
+{
+    size_t n = 0;
+    for (const auto &[key, active] : transfers_)
+        n += active.size();
+    return n;
 }
@@ -3,35 +3,100 @@
 #include <netinet/in.h>
 #include <sys/socket.h>
 #include <unistd.h>
+
+#include <chrono>
+#include <memory>
+#include <set>
+#include <unordered_map>
 #include <vector>
 
 #include "connection.hpp"
+#include "content_cache.hpp"
+#include "fanout_session.hpp"
+#include "file_transfer.hpp"
+#include "io_backend.hpp"
 #include "packet.hpp"
+#include "send_scheduler.hpp"
+#include "syn_cookie.hpp"
+#include "trace.hpp"
 
 class Protocol
 {
 public:
+    using Clock = std::chrono::steady_clock;
+
+    Protocol(IoBackend &io,
+             size_t cache_budget,
+             const SendScheduler::Options &sched,
+             const FanoutSession::Options &fanout,
+             Tracer &tracer)
+        : io_(io), cache_(cache_budget), tracer_(tracer),
+          scheduler_(sched, tracer), fanout_opts_(fanout)
+    {
+    }
+
+    // 無狀態地回應 SYN：SYN_ACK 的 seq 即為 SYN cookie
     Packet handleHandshake(const Packet &pkt,
-                           ConnectionState &state,
+                           const sockaddr_in &client_addr,
                            const std::string &client_key);
+    // 以 pkt.ack - 1 驗證 cookie，通過才建立連線狀態
+    bool acceptHandshake(const Packet &pkt,
+                         const sockaddr_in &client_addr,
+                         ConnectionState &state);
     Packet handleExpression(const std::string &expr, ConnectionState &state);
     std::vector<Packet> handleFileRequest(const std::string &filename,
                                           ConnectionState &state);
 
-    void sendFileWithCongestionControl(const std::string &filename,
-                                       ConnectionState &state,
-                                       int sockfd,
-                                       const sockaddr_in &client_addr);
-    std::vector<Packet> collectAckPackets(int sockfd, size_t expected_ack_count);
+    // 延遲敏感的回覆（SYN_ACK、EXPR_RES、keepalive）走排程器的 priority lane
+    void sendReply(const Packet &pkt, const sockaddr_in &client_addr);
 
-private:
-    Packet makeErrorPacket(ConnectionState &state, const std::string &msg);
-    Packet makeDataPacket(ConnectionState &state, const std::string &payload);
-    Packet makeEOFPacket(ConnectionState &state);
+    // 開始傳送檔案後立即返回；之後由 handleDataAck() 與 poll() 推進
+    void startFileTransfer(const std::string &filename,
+                           ConnectionState &state,
+                           const std::string &client_key,
+                           const sockaddr_in &client_addr);
+    void handleDataAck(const std::string &client_key, const Packet &ack);
 
-    void sendPacket(int sockfd,
-                    const Packet &pkt,
+    // 收集期間內請求同一個檔案的 client 合併成一個 fan-out session
+    void joinFanout(const std::string &filename,
+                    ConnectionState &state,
+                    const std::string &client_key,
                     const sockaddr_in &client_addr);
-    bool receivePacket(int sockfd, Packet &pkt, sockaddr_in *sender = nullptr);
+    void handleFanoutNak(const std::string &client_key, const Packet &nak);
+
+    // 以讀完的檔案開始傳輸、處理到期的傳輸計時器，
+    // 並把排程器選出的一批封包交給 I/O 後端；
+    // 回傳這次結束的傳輸（含 fan-out session）數
+    size_t poll(Clock::time_point now);
+    // 距離下一個計時器或可送出封包的毫秒數，-1 表示沒有任何待辦
+    int msUntilNextEvent(Clock::time_point now) const;
+
+    size_t activeTransfers() const;
+    size_t activeFanouts() const { return fanouts_.size(); }
+    const ContentCache::Stats &cacheStats() const { return cache_.stats(); }
+    const SendScheduler::Stats &schedulerStats() const
+    {
+        return scheduler_.stats();
+    }
+
+private:
+    Packet makeErrorPacket(ConnectionState &state, const std::string &msg);
+    // filename 還在收集接收者的 fan-out session；沒有時回傳 nullptr
+    FanoutSession *gatheringSession(const std::string &filename);
 
+    IoBackend &io_;
+    SynCookies cookies_;
+    ContentCache cache_;
+    Tracer &tracer_;
+    SendScheduler scheduler_;
+    // 每條連線進行中的傳輸；client 可以同時下載多個檔案
+    std::unordered_map<std::string, std::vector<std::unique_ptr<FileTransfer>>>
+        transfers_;
+    // 等待讀檔的 FILE_REQ（client key 與請求 seq），重送的請求不重複開始
+    std::set<std::pair<std::string, uint32_t>> loading_;
+    FanoutSession::Options fanout_opts_;
+    // 以 session id 索引；gathering_ 記錄每個檔案還在收集接收者的 session
+    std::unordered_map<uint32_t, std::unique_ptr<FanoutSession>> fanouts_;
+    std::unordered_map<std::string, uint32_t> gathering_;
+    uint32_t next_fanout_id_ = 1;
 };
@@ -0,0 +1,259 @@
+#include "send_scheduler.hpp"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+void logSend(const sockaddr_in &to,
+             PacketType type,
+             uint32_t seq,
+             uint32_t ack,
+             size_t size)
+{
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &(to.sin_addr), ip, INET_ADDRSTRLEN);
+    uint16_t port = ntohs(to.sin_port);
+
+    std::cout << "📤 sendPacket → " << ip << ":" << port
+              << " type=" << to_string(type) << " seq=" << seq
+              << " ack=" << ack << " size=" << size << "\n";
+}
+} // namespace
+
+SendScheduler::OutPacket SendScheduler::makeOut(
+    const sockaddr_in &to,
+    const Packet &pkt,
+    std::string_view payload,
+    std::shared_ptr<const void> owner) const
+{
+    OutPacket out{to,
+                  pkt.type,
+                  pkt.seq,
+                  pkt.ack,
+                  pkt.serializeHeader(),
+                  payload,
+                  std::move(owner),
+                  {}};
+    if (!out.owner)
+        out.head.append(pkt.payload);
+    return out;
+}
+
+void SendScheduler::pushPriority(const sockaddr_in &to, const Packet &pkt)
+{
+    priority_.push_back(makeOut(to, pkt, {}, {}));
+}
+
+void SendScheduler::pushBulk(const std::string &flow,
+                             const sockaddr_in &to,
+                             const Packet &pkt,
+                             std::string_view payload,
+                             std::shared_ptr<const void> owner)
+{
+    OutPacket out = makeOut(to, pkt, payload, std::move(owner));
+    if (opts_.fifo) {
+        out.flow = flow;
+        ++fifo_queued_[flow];
+        priority_.push_back(std::move(out));
+        return;
+    }
+
+    auto [it, inserted] = flows_.try_emplace(flow);
+    if (inserted) {
+        // 新的（或剛清空過的）flow 排到 DRR 佇列尾端；清空前的 bucket 若還沒
+        // 補滿就接續使用，否則從滿的開始
+        uint64_t rate = rateOf(flow);
+        auto parked = parked_.find(flow);
+        if (parked != parked_.end()) {
+            it->second.bucket = parked->second;
+            it->second.bucket.rate = rate;
+            parked_.erase(parked);
+        } else {
+            it->second.bucket = {burst(rate), Clock::now(), rate};
+        }
+        active_.push_back(flow);
+    }
+    it->second.queue.push_back(std::move(out));
+}
+
+void SendScheduler::transmit(IoBackend &io, OutPacket &out)
+{
+    logSend(out.to, out.type, out.seq, out.ack, out.size());
+    tracer_.record(out.to, TraceEvent::PacketSent, uint8_t(out.type), out.seq,
+                   out.size());
+    stats_.bytes_sent += out.size();
+    if (out.owner)
+        io.queueSendChunk(out.to, std::move(out.head), out.body,
+                          std::move(out.owner));
+    else
+        io.queueSend(out.to, std::move(out.head));
+}
+
+void SendScheduler::setRate(const std::string &flow, uint64_t rate)
+{
+    rates_[flow] = rate;
+    auto it = flows_.find(flow);
+    if (it == flows_.end())
+        return;
+    // 原本不限速的 flow 沒有累積額度，從滿的 bucket 開始
+    Bucket &bucket = it->second.bucket;
+    if (!bucket.rate)
+        bucket = {burst(rate), Clock::now(), rate};
+    bucket.rate = rate;
+}
+
+void SendScheduler::clearRate(const std::string &flow)
+{
+    rates_.erase(flow);
+}
+
+uint64_t SendScheduler::rateOf(const std::string &flow) const
+{
+    auto it = rates_.find(flow);
+    return it == rates_.end() ? opts_.rate_cap : it->second;
+}
+
+double SendScheduler::burst(uint64_t rate) const
+{
+    // 最多累積 50ms 的額度，且至少能送出一個 quantum。額度可能小於一個
+    // 封包（quantum 與速率上限都很小時），因此 dispatch() 允許隊首封包
+    // 先欠著 token，之後補滿前不再送出
+    return std::max<double>(opts_.quantum, rate / 20.0);
+}
+
+double SendScheduler::tokensAt(const Bucket &bucket,
+                               Clock::time_point now) const
+{
+    double secs = std::chrono::duration<double>(now - bucket.refilled).count();
+    return std::min(burst(bucket.rate), bucket.tokens + secs * bucket.rate);
+}
+
+void SendScheduler::parkBucket(const std::string &key,
+                               const Bucket &bucket,
+                               Clock::time_point now)
+{
+    // 已補滿的 bucket 與新的 flow 沒有差別，不必保留
+    if (!bucket.rate || tokensAt(bucket, now) >= burst(bucket.rate))
+        return;
+    parked_[key] = bucket;
+
+    // 不再出現的 flow 會留下 bucket；數量加倍時清掉已補滿的，攤銷後為 O(1)
+    if (parked_.size() >= prune_at_) {
+        std::erase_if(parked_, [&](const auto &entry) {
+            return tokensAt(entry.second, now) >= burst(entry.second.rate);
+        });
+        prune_at_ = std::max(kMinPrune, parked_.size() * 2);
+    }
+}
+
+size_t SendScheduler::dispatch(IoBackend &io, Clock::time_point now)
+{
+    size_t sent = 0;
+
+    // 1️⃣ priority lane（fifo 模式下所有封包都在這裡）
+    while (sent < opts_.budget && !priority_.empty()) {
+        OutPacket &out = priority_.front();
+        if (!out.flow.empty()) {
+            auto it = fifo_queued_.find(out.flow);
+            if (--it->second == 0)
+                fifo_queued_.erase(it);
+            ++stats_.bulk_sent;
+        } else {
+            ++stats_.priority_sent;
+        }
+        transmit(io, out);
+        priority_.pop_front();
+        ++sent;
+    }
+
+    // 2️⃣ bulk lane：deficit round-robin；所有 flow 都輪過一次仍沒有進展就停止
+    size_t stalled = 0;
+    while (sent < opts_.budget && stalled < active_.size()) {
+        std::string key = std::move(active_.front());
+        active_.pop_front();
+        Flow &flow = flows_.at(key);
+
+        if (flow.bucket.rate)
+            flow.bucket = {tokensAt(flow.bucket, now), now, flow.bucket.rate};
+        if (!flow.in_turn) {
+            flow.deficit += opts_.quantum;
+            flow.in_turn = true;
+        }
+
+        bool progressed = false;
+        while (sent < opts_.budget && !flow.queue.empty()) {
+            OutPacket &out = flow.queue.front();
+            size_t size = out.size();
+            if (size > flow.deficit ||
+                (flow.bucket.rate && flow.bucket.tokens < 0))
+                break;
+            flow.deficit -= size;
+            flow.bucket.tokens -= size;
+            transmit(io, out);
+            flow.queue.pop_front();
+            ++stats_.bulk_sent;
+            ++sent;
+            progressed = true;
+        }
+
+        // 佇列清空的 flow 不保留 deficit，只留下還欠著額度的 bucket
+        if (flow.queue.empty()) {
+            parkBucket(key, flow.bucket, now);
+            flows_.erase(key);
+            stalled = 0;
+            continue;
+        }
+
+        if (flow.queue.front().size() > flow.deficit) {
+            // 本輪的 quantum 用完，換下一條 flow
+            flow.in_turn = false;
+            active_.push_back(std::move(key));
+        } else if (sent >= opts_.budget) {
+            // 本次額度用完，下次 dispatch 從這條 flow 的剩餘 deficit 繼續
+            active_.push_front(std::move(key));
+            break;
+        } else {
+            // 被速率上限擋住，保留 deficit 等欠下的 token 還清
+            active_.push_back(std::move(key));
+        }
+        stalled = progressed ? 0 : stalled + 1;
+    }
+    return sent;
+}
+
+int SendScheduler::msUntilReady(Clock::time_point now) const
+{
+    if (!priority_.empty())
+        return 0;
+    if (active_.empty())
+        return -1;
+    if (!opts_.rate_cap && rates_.empty())
+        return 0;
+
+    double wait = INFINITY;
+    for (const std::string &key : active_) {
+        const Bucket &bucket = flows_.at(key).bucket;
+        if (!bucket.rate)
+            return 0;
+        // 還有 token（即使不夠一整個封包）就可以送出，欠的額度之後償還
+        double debt = -tokensAt(bucket, now);
+        if (debt <= 0)
+            return 0;
+        wait = std::min(wait, debt * 1000.0 / bucket.rate);
+    }
+    return int(std::ceil(wait));
+}
+
+size_t SendScheduler::queued(const std::string &flow) const
+{
+    if (opts_.fifo) {
+        auto it = fifo_queued_.find(flow);
+        return it == fifo_queued_.end() ? 0 : it->second;
+    }
+    auto it = flows_.find(flow);
+    return it == flows_.end() ? 0 : it->second.queue.size();
+}
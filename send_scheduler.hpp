@@ -0,0 +1,139 @@
+#pragma once
+#include <netinet/in.h>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "io_backend.hpp"
+#include "packet.hpp"
+#include "trace.hpp"
+
+// server 的送出排程：所有封包先排進這裡，每次 dispatch() 最多交給 I/O 後端
+// budget 個封包；一輪送出整個視窗時，工作也會分散在多次 dispatch() 中。
+//
+// - priority lane：EXPR_RES、SYN_ACK、keepalive、FILE_ERR 等延遲敏感的回覆，嚴格優先
+// - bulk lane：每條連線（flow）一個佇列，以 deficit round-robin 依 byte quantum
+//   輪流送出，單一大檔案下載無法獨佔送出額度；可選擇以 token bucket 限制每條連線的速率
+//
+// fifo 模式關閉上述機制，所有封包依排入順序送出，供比較用。
+class SendScheduler
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Options {
+        bool fifo = false;
+        // 每條連線每一輪可送出的 bytes
+        size_t quantum = 1500;
+        // 每次 dispatch() 最多送出的封包數
+        size_t budget = 64;
+        // 每條連線的速率上限（bytes/s），0 表示不限
+        uint64_t rate_cap = 0;
+    };
+
+    struct Stats {
+        uint64_t priority_sent = 0;
+        uint64_t bulk_sent = 0;
+        // 交給 I/O 後端的 UDP payload 總量（含表頭）
+        uint64_t bytes_sent = 0;
+    };
+
+    SendScheduler(const Options &opts, Tracer &tracer)
+        : opts_(opts), tracer_(tracer)
+    {
+    }
+
+    void pushPriority(const sockaddr_in &to, const Packet &pkt);
+
+    // payload 非空時不複製，owner 保證其記憶體在真正送出前有效
+    void pushBulk(const std::string &flow,
+                  const sockaddr_in &to,
+                  const Packet &pkt,
+                  std::string_view payload = {},
+                  std::shared_ptr<const void> owner = {});
+
+    // 依優先順序把封包交給 I/O 後端，回傳送出的封包數
+    size_t dispatch(IoBackend &io, Clock::time_point now);
+
+    // flow 專屬的速率上限（bytes/s，0 表示不限），取代 Options::rate_cap；
+    // flow 不再使用時以 clearRate() 移除
+    void setRate(const std::string &flow, uint64_t rate);
+    void clearRate(const std::string &flow);
+
+    // 0：有封包可以立即送出；-1：沒有任何待送封包；
+    // 其他：所有待送封包都被速率上限擋住，最快可送出前的毫秒數
+    int msUntilReady(Clock::time_point now) const;
+
+    // flow 在 bulk lane 中尚未送出的封包數
+    size_t queued(const std::string &flow) const;
+
+    const Stats &stats() const { return stats_; }
+
+private:
+    struct OutPacket {
+        sockaddr_in to;
+        // 只留下記錄 log 需要的欄位，真正交給 I/O 後端時才輸出
+        PacketType type;
+        uint32_t seq;
+        uint32_t ack;
+        std::string head;
+        std::string_view body;
+        std::shared_ptr<const void> owner;
+        // fifo 模式用來計算每條連線尚未送出的封包數
+        std::string flow;
+
+        size_t size() const { return head.size() + body.size(); }
+    };
+
+    // 速率上限的 token bucket；tokens 可能為負：隊首封包大於剩餘額度時
+    // 先欠著，補回正值前不再送出。rate 為 0 時不限速
+    struct Bucket {
+        double tokens = 0;
+        Clock::time_point refilled;
+        uint64_t rate = 0;
+    };
+
+    struct Flow {
+        std::deque<OutPacket> queue;
+        size_t deficit = 0;
+        // 本輪的 quantum 已加入 deficit
+        bool in_turn = false;
+        Bucket bucket;
+    };
+
+    OutPacket makeOut(const sockaddr_in &to,
+                      const Packet &pkt,
+                      std::string_view payload,
+                      std::shared_ptr<const void> owner) const;
+    void transmit(IoBackend &io, OutPacket &out);
+    uint64_t rateOf(const std::string &flow) const;
+    double burst(uint64_t rate) const;
+    double tokensAt(const Bucket &bucket, Clock::time_point now) const;
+    // 佇列清空的 flow 移除前保留尚未補滿的 bucket
+    void parkBucket(const std::string &key,
+                    const Bucket &bucket,
+                    Clock::time_point now);
+
+    // parked_ 超過這個數量才開始清理已補滿的 bucket
+    static constexpr size_t kMinPrune = 1024;
+
+    Options opts_;
+    Tracer &tracer_;
+    std::deque<OutPacket> priority_;
+    std::unordered_map<std::string, Flow> flows_;
+    // 有待送封包的 flow，依 DRR 輪到的順序
+    std::deque<std::string> active_;
+    // 佇列清空時尚未補滿的 bucket：flow 再次排入封包時接續使用，
+    // 只依經過的時間補充，清空再排入不會重新拿到滿的額度
+    std::unordered_map<std::string, Bucket> parked_;
+    size_t prune_at_ = kMinPrune;
+    // setRate() 指定的 flow 速率
+    std::unordered_map<std::string, uint64_t> rates_;
+    std::unordered_map<std::string, size_t> fifo_queued_;
+    Stats stats_;
+};
@@ -3,12 +3,17 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstring>
+#include <deque>
 #include <iostream>
-#include <unordered_map>
+#include <tuple>
 
+#include "connection_table.hpp"
+#include "io_backend.hpp"
 #include "packet.hpp"
 #include "protocol.hpp"
+#include "trace.hpp"
 
 std::string getClientKey(const sockaddr_in &addr)
 {
@@ -17,13 +22,100 @@ std::string getClientKey(const sockaddr_in &addr)
     return std::string(ip) + ":" + std::to_string(ntohs(addr.sin_port));
 }
 
-int main()
+// 統計行立即 flush，stdout 接到 pipe 時也能即時讀到
+void printStats(const Protocol &protocol)
 {
+    const ContentCache::Stats &c = protocol.cacheStats();
+    uint64_t lookups = c.hits + c.misses;
+    std::cout << "📊 content cache：命中率 "
+              << (lookups ? 100.0 * c.hits / lookups : 0.0) << "%（hit="
+              << c.hits << " miss=" << c.misses << "）entries=" << c.entries
+              << " bytes=" << c.bytes << " evictions=" << c.evictions << "\n";
+    const SendScheduler::Stats &s = protocol.schedulerStats();
+    std::cout << "📊 送出排程：priority=" << s.priority_sent
+              << " bulk=" << s.bulk_sent << " bytes=" << s.bytes_sent
+              << " 進行中的傳輸=" << protocol.activeTransfers()
+              << " fan-out=" << protocol.activeFanouts() << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    // 🔧 --io=<auto|io_uring|epoll|socket> 選擇 I/O 後端（auto 即 epoll）
+    // 🔧 --cache-mb=<N> content cache 記憶體上限（預設 64 MB）
+    // 🔧 --idle-timeout=<秒> 閒置多久移除連線（預設 120，0 表示不移除）
+    // 🔧 --keepalive=<秒> 閒置多久送出 keepalive probe（預設為閒置逾時的
+    //    1/4；0 表示不送）。cookie 只有 64～128 秒有效，client 閒置期間
+    //    必須靠 probe 維持連線，否則被淘汰後只能等 RST 再重新握手
+    // 🔧 --sched=<drr|fifo> 送出排程方式（預設 drr）
+    // 🔧 --quantum=<bytes> DRR 每條連線每輪可送出的 bytes（預設 1500）
+    // 🔧 --rate-cap-kb=<KB/s> 每條連線的送出速率上限（預設 0，不限）
+    // 🔧 --trace-dir=<dir> 啟用事件追蹤，執行期間以 <dir>/enabled 選擇連線
+    // 🔧 --fanout-wait-ms=<ms> fan-out 收集接收者的時間（預設 200）
+    // 🔧 --fanout-group=<ip:port> fan-out 資料改以 IP multicast 送到此群組
+    // 🔧 --fanout-if=<ip> 送出 multicast 的介面位址（預設由路由決定）
+    // 🔧 --fanout-rate-kb=<KB/s> fan-out 對每個接收者（multicast 時為整個
+    //    群組）的送出速率上限（預設 16384；0 表示沿用 --rate-cap-kb）
+    std::string io_name = "auto";
+    size_t cache_mb = 64;
+    long idle_timeout = 120;
+    long keepalive = -1;
+    SendScheduler::Options sched;
+    std::string trace_dir;
+    FanoutSession::Options fanout;
+    fanout.rate = 16384 * 1024;
+    std::string fanout_if;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--io=", 0) == 0)
+            io_name = arg.substr(5);
+        else if (arg.rfind("--cache-mb=", 0) == 0)
+            cache_mb = std::stoul(arg.substr(11));
+        else if (arg.rfind("--idle-timeout=", 0) == 0)
+            idle_timeout = std::stol(arg.substr(15));
+        else if (arg.rfind("--keepalive=", 0) == 0)
+            keepalive = std::stol(arg.substr(12));
+        else if (arg.rfind("--sched=", 0) == 0)
+            sched.fifo = arg.substr(8) == "fifo";
+        else if (arg.rfind("--quantum=", 0) == 0)
+            sched.quantum = std::max<size_t>(std::stoul(arg.substr(10)), 1);
+        else if (arg.rfind("--rate-cap-kb=", 0) == 0)
+            sched.rate_cap = std::stoull(arg.substr(14)) * 1024;
+        else if (arg.rfind("--trace-dir=", 0) == 0)
+            trace_dir = arg.substr(12);
+        else if (arg.rfind("--fanout-wait-ms=", 0) == 0)
+            fanout.gather_ms = std::stoi(arg.substr(17));
+        else if (arg.rfind("--fanout-group=", 0) == 0) {
+            std::string group = arg.substr(15);
+            size_t colon = group.rfind(':');
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            if (colon == std::string::npos ||
+                inet_pton(AF_INET, group.substr(0, colon).c_str(),
+                          &addr.sin_addr) != 1 ||
+                !IN_MULTICAST(ntohl(addr.sin_addr.s_addr))) {
+                std::cerr << "❌ 無效的 multicast 群組：" << group << "\n";
+                return 1;
+            }
+            addr.sin_port = htons(std::stoi(group.substr(colon + 1)));
+            fanout.group = addr;
+        } else if (arg.rfind("--fanout-if=", 0) == 0)
+            fanout_if = arg.substr(12);
+        else if (arg.rfind("--fanout-rate-kb=", 0) == 0)
+            fanout.rate = std::stoull(arg.substr(17)) * 1024;
+    }
+    // fan-out 的專屬速率不超過整體的 rate cap
+    if (sched.rate_cap && fanout.rate > sched.rate_cap)
+        fanout.rate = sched.rate_cap;
+
     int sock = socket(AF_INET, SOCK_DGRAM, 0);
     if (sock < 0) {
         std::cerr << "❌ 無法建立 socket\n";
         return 1;
     }
+    // 每一輪的 DATA_ACK 會整個視窗一起湧入；接收緩衝區太小時，夾在其中的
+    // EXPR_REQ 會在進到排程器之前就被 kernel 丟掉（實際上限為 rmem_max）
+    int rcvbuf = 4 << 20;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
 
     sockaddr_in server_addr{};
     server_addr.sin_family = AF_INET;
@@ -35,90 +127,246 @@ int main()
         return 1;
     }
 
-    std::unordered_map<std::string, ConnectionState> connections;
-    Protocol protocol;
+    // multicast 的 TTL 維持預設的 1，只送到本地網段；IP_MULTICAST_LOOP 預設
+    // 開啟，同一台主機上的接收者也收得到
+    if (fanout.group && !fanout_if.empty()) {
+        in_addr iface{};
+        inet_pton(AF_INET, fanout_if.c_str(), &iface);
+        setsockopt(sock, IPPROTO_IP, IP_MULTICAST_IF, &iface, sizeof(iface));
+    }
 
-    std::cout << "✅ Server 已啟動，等待封包...\n";
+    if (keepalive < 0)
+        keepalive = idle_timeout / 4;
 
-    while (true) {
-        char buffer[4096];
-        sockaddr_in client_addr{};
-        socklen_t len = sizeof(client_addr);
+    std::unique_ptr<IoBackend> io = makeIoBackend(sock, io_name);
+    ConnectionTable connections{std::chrono::seconds(idle_timeout),
+                                std::chrono::seconds(keepalive)};
+    Tracer tracer;
+    if (!trace_dir.empty())
+        tracer.enable(trace_dir);
+    Protocol protocol(*io, cache_mb << 20, sched, fanout, tracer);
 
-        ssize_t n = recvfrom(sock, buffer, sizeof(buffer), 0,
-                             (sockaddr *) &client_addr, &len);
-        if (n <= 0)
-            continue;
+    // 💓 keepalive probe：seq 為 server 已用過的最後一個序號（類似 TCP 的
+    // seq - 1 探測），client 以 ACK 回應
+    auto probe = [&protocol](const sockaddr_in &addr, ConnectionState &state) {
+        Packet ka{state.server_seq - 1, state.client_seq, state.window_size,
+                  PacketType::ACK, ""};
+        protocol.sendReply(ka, addr);
+        std::cout << "💓 keepalive probe → " << getClientKey(addr) << "\n";
+    };
+    // 被淘汰的連線不會再有事件，追蹤所有連線時關閉它的追蹤檔
+    auto evicted = [&tracer](const sockaddr_in &addr) { tracer.close(addr); };
+    // 🔍 追蹤所有連線時只追蹤完成握手（通過 cookie 驗證）的連線
+    tracer.setFilter([&connections](const sockaddr_in &addr) {
+        return connections.find(getClientKey(addr)) != nullptr;
+    });
 
-        std::string raw(buffer, n);
-        Packet pkt = Packet::deserialize(raw);
+    std::cout << "✅ Server 已啟動（I/O 後端：" << io->name() << "，排程："
+              << (sched.fifo ? "fifo" : "drr") << "），等待封包...\n";
+    if (fanout.group)
+        std::cout << "📡 fan-out 以 multicast 送出："
+                  << getClientKey(*fanout.group) << "\n";
+
+    // 處理一個收到的封包；回應一律交給排程器，不會在這裡阻塞
+    // bytes 為 datagram 的大小，只用於事件追蹤
+    auto handlePacket = [&](const sockaddr_in &client_addr,
+                            const Packet &pkt,
+                            size_t bytes) {
         std::string client_key = getClientKey(client_addr);
+        // 在確認對方已握手之後才記錄，未驗證的來源不會留下追蹤
+        auto traceReceived = [&] {
+            tracer.record(client_addr, TraceEvent::PacketReceived,
+                          uint8_t(pkt.type), pkt.seq, bytes);
+        };
 
         // 🆕 Debug: 顯示收到封包類型與 client key
         std::cout << "📥 收到封包：" << to_string(pkt.type) << " from "
                   << client_key << "\n";
 
-        // 🧩 尚未建立連線
-        if (!connections.contains(client_key)) {
-            if (pkt.type == PacketType::SYN) {
-                connections[client_key] =
-                    ConnectionState{pkt.seq, 1000, 1024, false};
+        // 🧩 SYN：不配置任何狀態，只回傳帶 cookie 的 SYN-ACK
+        if (pkt.type == PacketType::SYN) {
+            if (connections.find(client_key))
+                traceReceived();
+            Packet syn_ack =
+                protocol.handleHandshake(pkt, client_addr, client_key);
+            protocol.sendReply(syn_ack, client_addr);
+            std::cout << "🚀 傳送 SYN-ACK 給 " << client_key << "\n";
+
+            PacketType early_type;
+            std::string early_payload;
+            std::string syn_payload = pkt.payload;
+            uint8_t wscale = 0;
+            stripWindowScale(syn_payload, wscale);
+            if (!parseEarlyData(syn_payload, early_type, early_payload))
+                return;
 
-                // 🆕 傳入 client_key 以設定 payload
-                Packet syn_ack = protocol.handleHandshake(
-                    pkt, connections[client_key], client_key);
-                std::string serialized = syn_ack.serialize();
-                sendto(sock, serialized.c_str(), serialized.size(), 0,
-                       (sockaddr *) &client_addr, len);
+            // ⚡ 0-RTT EXPR_REQ：回應不比請求大，直接以暫時狀態算完
+            if (early_type == PacketType::EXPR_REQ) {
+                ConnectionState once{pkt.seq, syn_ack.seq + 1, 1024, true};
+                Packet res = protocol.handleExpression(early_payload, once);
+                protocol.sendReply(res, client_addr);
+                std::cout << "⚡ 0-RTT EXPR_REQ：" << client_key << "\n";
+                return;
+            }
 
-                std::cout << "🚀 傳送 SYN-ACK 給 " << client_key << "\n";
+            // ⚡ 0-RTT FILE_REQ 需要狀態：SYN 的 ack 必須帶著先前取得的 cookie。
+            // 已知的 client 也要驗證，否則偽造來源位址就能讓 server 送出檔案
+            ConnectionState accepted;
+            if (!protocol.acceptHandshake(pkt, client_addr, accepted)) {
+                std::cout << "⚠️ 0-RTT FILE_REQ 沒有有效 cookie，等待握手："
+                          << client_key << "\n";
+                return;
+            }
+            ConnectionState *early = connections.find(client_key);
+            if (early) {
+                ConnectionTable::touch(*early);
             } else {
+                early = &connections.add(client_key, client_addr, accepted);
+                traceReceived();
+            }
+            std::cout << "⚡ 0-RTT FILE_REQ：" << client_key << "\n";
+            early->client_seq = pkt.seq;
+            protocol.startFileTransfer(early_payload, *early, client_key,
+                                       client_addr);
+            printStats(protocol);
+            return;
+        }
+
+        // 🤝 尚未建立連線：ACK 或第一個請求的 ack 通過 cookie 驗證才配置狀態
+        ConnectionState *known = connections.find(client_key);
+        if (!known) {
+            ConnectionState established;
+            if (!protocol.acceptHandshake(pkt, client_addr, established)) {
                 std::cerr << "⚠️ 未握手的 client 嘗試傳送資料：" << client_key
                           << "\n";
+                // 請求沒有回應 client 只會一直重送；回覆 RST 讓它重新握手
+                if (pkt.type == PacketType::EXPR_REQ ||
+                    pkt.type == PacketType::FILE_REQ ||
+                    pkt.type == PacketType::FANOUT_REQ)
+                    protocol.sendReply({0, pkt.seq, 0, PacketType::RST, ""},
+                                       client_addr);
+                return;
             }
-            continue;
+            known = &connections.add(client_key, client_addr, established);
+            traceReceived();
+            std::cout << "🤝 完成握手：" << client_key << "（rwnd="
+                      << established.peer_window
+                      << " wscale=" << int(established.peer_window_scale)
+                      << "，連線數 " << connections.size() << "）\n";
+            if (pkt.type == PacketType::ACK)
+                return;
+        } else {
+            traceReceived();
         }
 
-        auto &state = connections[client_key];
-
-        // 🤝 完成三次握手
-        if (!state.handshake_done && pkt.type == PacketType::ACK) {
-            state.handshake_done = true;
-            std::cout << "🤝 完成握手：" << client_key << "\n";
-            continue;
-        }
+        auto &state = *known;
+        ConnectionTable::touch(state);
+        state.updatePeerWindow(pkt.window);
 
         Packet response;
 
         switch (pkt.type) {
+        // 回應的 ack 欄位帶回請求的 seq，client 據此對應同時進行中的多個請求
         case PacketType::EXPR_REQ:
+            state.client_seq = pkt.seq;
             response = protocol.handleExpression(pkt.payload, state);
             break;
 
-        case PacketType::FILE_REQ: {
-            struct timeval tv = {5, 0}; // 5 秒 timeout
-            setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
-            protocol.sendFileWithCongestionControl(pkt.payload, state, sock,
-                                                   client_addr);
-            continue;
-        }
-
+        case PacketType::FILE_REQ:
+            state.client_seq = pkt.seq;
+            protocol.startFileTransfer(pkt.payload, state, client_key,
+                                       client_addr);
+            printStats(protocol);
+            return;
 
         case PacketType::DATA_ACK:
-            std::cout << "📬 收到 client ACK：" << pkt.ack << "\n";
-            continue;
+            std::cout << "📬 收到 client ACK：" << pkt.seq - 1 << "（請求 "
+                      << pkt.ack << "）\n";
+            protocol.handleDataAck(client_key, pkt);
+            return;
+
+        case PacketType::FANOUT_REQ:
+            state.client_seq = pkt.seq;
+            protocol.joinFanout(pkt.payload, state, client_key, client_addr);
+            return;
+
+        case PacketType::FANOUT_NAK:
+            protocol.handleFanoutNak(client_key, pkt);
+            return;
+
+        // 握手的重複 ACK 或 keepalive 的回應，touch() 已更新 last_active
+        case PacketType::ACK:
+            return;
 
         default:
             std::cerr << "⚠️ 未知封包類型：" << to_string(pkt.type) << "\n";
-            continue;
+            return;
         }
 
         // 📨 傳送回應（EXPR_REQ）
-        std::string serialized = response.serialize();
-        sendto(sock, serialized.c_str(), serialized.size(), 0,
-               (sockaddr *) &client_addr, len);
+        protocol.sendReply(response, client_addr);
+    };
+
+    // DATA_ACK 先暫存在 backlog，同一批讀進來的請求與握手優先處理；
+    // bulk 傳輸的 ACK 整個視窗一起湧入時，EXPR_REQ 不必排在幾千個 ACK 後面
+    constexpr size_t kMaxDrain = 1024;
+    constexpr size_t kAckBatch = 64;
+    constexpr size_t kMaxAckBacklog = 4096;
+    // 每筆為來源位址、封包與 datagram 大小
+    std::deque<std::tuple<sockaddr_in, Packet, size_t>> ack_backlog;
+
+    while (true) {
+        // 每一輪都推進計時器並送出一批封包；最多等到下一個 timing wheel tick
+        // 或傳輸計時器，排程器還有可送的封包或 backlog 還有 ACK 時不等待
+        auto now = std::chrono::steady_clock::now();
+        connections.expire(now, probe, evicted);
+        tracer.poll(now);
+        // 有傳輸結束時也印出統計，可看出整個傳輸送出的 bytes
+        if (protocol.poll(now) > 0)
+            printStats(protocol);
+        int wait = connections.msUntilNextCheck(now);
+        int next_event = protocol.msUntilNextEvent(now);
+        if (next_event >= 0 && (wait < 0 || next_event < wait))
+            wait = next_event;
+        if (!ack_backlog.empty())
+            wait = 0;
+
+        // 1️⃣ 讀出 kernel 中已到達的封包：請求立即處理，DATA_ACK 排進 backlog
+        Datagram dgram;
+        for (size_t n = 0;
+             n < kMaxDrain && io->receive(dgram, n == 0 ? wait : 0); ++n) {
+            // 任何人都能送 datagram 進來，格式不對的封包直接丟棄
+            Packet pkt;
+            try {
+                pkt = Packet::deserialize(dgram.data);
+            } catch (const std::exception &) {
+                std::cerr << "⚠️ 收到無法解析的封包，已丟棄 ← "
+                          << getClientKey(dgram.addr) << "\n";
+                continue;
+            }
+            if (pkt.type != PacketType::DATA_ACK) {
+                handlePacket(dgram.addr, pkt, dgram.data.size());
+                continue;
+            }
+            // backlog 滿了就丟掉 ACK（如同 kernel 丟封包），由壅塞控制退讓
+            if (ack_backlog.size() >= kMaxAckBacklog) {
+                std::cout << "🗑️ DATA_ACK backlog 已滿，丟棄 ← "
+                          << getClientKey(dgram.addr) << "\n";
+                continue;
+            }
+            ack_backlog.push_back(
+                {dgram.addr, std::move(pkt), dgram.data.size()});
+        }
+
+        // 2️⃣ 每一輪最多處理 kAckBatch 個 DATA_ACK，再回頭檢查新的請求
+        for (size_t n = 0; n < kAckBatch && !ack_backlog.empty(); ++n) {
+            auto [client_addr, pkt, bytes] = std::move(ack_backlog.front());
+            ack_backlog.pop_front();
+            handlePacket(client_addr, pkt, bytes);
+        }
     }
 
+    io.reset();
     close(sock);
     return 0;
 }
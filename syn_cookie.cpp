@@ -0,0 +1,105 @@
+#include "syn_cookie.hpp"
+
+#include <chrono>
+#include <random>
+
+namespace
+{
+uint64_t rotl(uint64_t x, int b)
+{
+    return (x << b) | (x >> (64 - b));
+}
+
+void sipRound(uint64_t &v0, uint64_t &v1, uint64_t &v2, uint64_t &v3)
+{
+    v0 += v1;
+    v1 = rotl(v1, 13);
+    v1 ^= v0;
+    v0 = rotl(v0, 32);
+    v2 += v3;
+    v3 = rotl(v3, 16);
+    v3 ^= v2;
+    v0 += v3;
+    v3 = rotl(v3, 21);
+    v3 ^= v0;
+    v2 += v1;
+    v1 = rotl(v1, 17);
+    v1 ^= v2;
+    v2 = rotl(v2, 32);
+}
+
+// SipHash-2-4，輸入固定為兩個 64-bit word
+uint64_t siphash24(const uint64_t key[2], uint64_t m0, uint64_t m1)
+{
+    uint64_t v0 = 0x736f6d6570736575ULL ^ key[0];
+    uint64_t v1 = 0x646f72616e646f6dULL ^ key[1];
+    uint64_t v2 = 0x6c7967656e657261ULL ^ key[0];
+    uint64_t v3 = 0x7465646279746573ULL ^ key[1];
+
+    for (uint64_t m : {m0, m1, uint64_t(16) << 56}) {
+        v3 ^= m;
+        sipRound(v0, v1, v2, v3);
+        sipRound(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+
+    v2 ^= 0xff;
+    for (int i = 0; i < 4; ++i)
+        sipRound(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+} // namespace
+
+SynCookies::SynCookies()
+{
+    std::random_device rd;
+    for (uint64_t &k : key_)
+        k = (uint64_t(rd()) << 32) | rd();
+}
+
+uint32_t SynCookies::currentSlot() const
+{
+    auto now = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration_cast<std::chrono::seconds>(now).count() /
+           kSlotSeconds;
+}
+
+uint32_t SynCookies::hash(const sockaddr_in &addr,
+                          uint32_t slot,
+                          uint32_t params) const
+{
+    uint64_t m0 = (uint64_t(addr.sin_addr.s_addr) << 32) | slot;
+    return siphash24(key_, m0, params) & kMacMask;
+}
+
+uint32_t SynCookies::make(const sockaddr_in &addr,
+                          uint16_t window,
+                          uint8_t wscale) const
+{
+    // 取不超過 client 通告值的最大表格項
+    uint32_t idx = 0;
+    while (idx + 1 < 8 && kWindowTable[idx + 1] <= window)
+        ++idx;
+
+    uint32_t params = (idx << 4) | (wscale & 0xf);
+    uint32_t slot = currentSlot();
+    return ((slot & 1) << 31) | (params << kMacBits) | hash(addr, slot, params);
+}
+
+bool SynCookies::check(const sockaddr_in &addr,
+                       uint32_t cookie,
+                       uint16_t &window,
+                       uint8_t &wscale) const
+{
+    // 最低位與目前的時間槽相同就是這一格，不同就是前一格
+    uint32_t now = currentSlot();
+    uint32_t slot = now - ((now ^ (cookie >> 31)) & 1);
+
+    uint32_t params = (cookie >> kMacBits) & 0x7f;
+    if (hash(addr, slot, params) != (cookie & kMacMask))
+        return false;
+
+    window = kWindowTable[params >> 4];
+    wscale = params & 0xf;
+    return true;
+}
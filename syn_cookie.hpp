@@ -0,0 +1,43 @@
+#pragma once
+#include <netinet/in.h>
+
+#include <cstdint>
+
+// SYN cookie：把連線參數編碼進 SYN_ACK 的 seq，server 在收到 SYN 時不配置任何狀態。
+//
+//   bit 31      時間槽（每 64 秒一格）的最低位
+//   bit 30..28  client 通告視窗的索引（見 kWindowTable）
+//   bit 27..24  client 要求的 window scale（0..14，0 表示未協商）
+//   bit 23..0   SipHash-2-4(key, client ip, 時間槽, 參數) 的低 24 bits
+//
+// 只接受目前這一格與前一格的 cookie，時間槽只需 1 bit 分辨是哪一格；
+// 完整的時間槽包含在 MAC 中，更舊的 cookie 會在 MAC 比對時失敗。
+// 其餘 bits 都留給 MAC：每個 client IP、每個時間槽約需 2^24 次嘗試才能偽造。
+//
+// cookie 只綁 client IP（不含 port），因此同一台主機稍後的新連線
+// 也可以帶著它在 SYN 上直接送出需要狀態的 0-RTT 請求（類似 TCP Fast Open）。
+class SynCookies
+{
+public:
+    SynCookies();
+
+    uint32_t make(const sockaddr_in &addr, uint16_t window, uint8_t wscale) const;
+
+    // 驗證成功時回傳 true 並解出 client 通告的視窗與 window scale
+    bool check(const sockaddr_in &addr,
+               uint32_t cookie,
+               uint16_t &window,
+               uint8_t &wscale) const;
+
+private:
+    static constexpr uint32_t kSlotSeconds = 64;
+    static constexpr uint32_t kMacBits = 24;
+    static constexpr uint32_t kMacMask = (1u << kMacBits) - 1;
+    static constexpr uint16_t kWindowTable[8] = {16,   64,   256,  512,
+                                                 1024, 2048, 4096, 8192};
+
+    uint32_t currentSlot() const;
+    uint32_t hash(const sockaddr_in &addr, uint32_t slot, uint32_t params) const;
+
+    uint64_t key_[2];
+};
@@ -0,0 +1,130 @@
+// 同一條連線同時下載多個檔案：各傳輸的 seq 範圍會重疊，
+// 檢查每個下載都收到正確的內容，且 server 沒有把 ACK 交錯給別的傳輸
+//   ./test_concurrent_download [server 參數...]
+// 自行啟動 ./server；loopback 上不會掉封包，server 判定任何封包遺失
+// （ACK 被其他傳輸吃掉時會發生）都視為失敗。成功時 exit code 為 0。
+#include <arpa/inet.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.hpp"
+#include "client_connection.hpp"
+#include "event_loop.hpp"
+
+namespace
+{
+constexpr size_t kDownloads = 4;
+constexpr size_t kLines = 3000;
+
+struct Download {
+    std::string filename;
+    std::vector<std::string> expected;
+    std::vector<std::string> received;
+    bool ok = false;
+};
+
+// 每個檔案的內容都不同，收錯檔案的資料也能被發現
+void writeFile(Download &d, size_t index)
+{
+    d.filename = "test_concurrent_" + std::to_string(index) + ".txt";
+    std::filesystem::create_directories("files");
+    std::ofstream out(std::filesystem::path("files") / d.filename);
+    for (size_t i = 0; i < kLines; ++i) {
+        d.expected.push_back("file " + std::to_string(index) + " line " +
+                             std::to_string(i));
+        out << d.expected.back() << "\n";
+    }
+}
+
+// 讀完 server 的輸出，回傳判定封包遺失的次數
+size_t countLosses(int fd)
+{
+    FILE *in = fdopen(fd, "r");
+    char line[4096];
+    size_t losses = 0;
+    while (std::fgets(line, sizeof(line), in))
+        if (std::strstr(line, "Timeout or loss"))
+            ++losses;
+    std::fclose(in);
+    return losses;
+}
+
+Task<void> receive(ClientConnection &conn, Download &d)
+{
+    d.ok = co_await conn.download(d.filename, [&d](std::string_view line) {
+        d.received.emplace_back(line);
+    });
+}
+
+Task<bool> sleepFor(EventLoop &loop, int ms)
+{
+    co_await loop.sleep(ms);
+    co_return true;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> server_args(argv + 1, argv + argc);
+    std::vector<Download> downloads(kDownloads);
+    for (size_t i = 0; i < kDownloads; ++i)
+        writeFile(downloads[i], i);
+
+    sockaddr_in server{};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(9000);
+    server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    waitForPort(server);
+    int out_fd = -1;
+    pid_t server_pid = startServer(server_args, &out_fd);
+    if (server_pid < 0) {
+        std::fprintf(stderr, "❌ 無法啟動 server\n");
+        return 1;
+    }
+    // server 的輸出必須持續讀取，否則 pipe 滿了 server 會卡住
+    size_t losses = 0;
+    std::thread reader([&] { losses = countLosses(out_fd); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    EventLoop loop;
+    ClientConnection conn(loop, server);
+    bool connected = loop.runUntilComplete(conn.connect());
+    if (connected) {
+        for (Download &d : downloads)
+            loop.spawn(receive(conn, d));
+        loop.run();
+        // 等 server 收到最後的 ACK
+        loop.runUntilComplete(sleepFor(loop, 200));
+    }
+
+    kill(server_pid, SIGTERM);
+    waitpid(server_pid, nullptr, 0);
+    reader.join();
+    for (const Download &d : downloads)
+        std::filesystem::remove(std::filesystem::path("files") / d.filename);
+
+    if (!connected) {
+        std::fprintf(stderr, "❌ 無法連上 server\n");
+        return 1;
+    }
+    bool passed = true;
+    for (const Download &d : downloads) {
+        bool match = d.ok && d.received == d.expected;
+        std::printf("%s %s：%zu/%zu 行\n", match ? "✅" : "❌",
+                    d.filename.c_str(), d.received.size(), d.expected.size());
+        passed = passed && match;
+    }
+    std::printf("%s server 判定遺失的封包：%zu\n", losses ? "❌" : "✅", losses);
+    return passed && losses == 0 ? 0 : 1;
+}
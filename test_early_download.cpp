@@ -0,0 +1,138 @@
+// 0-RTT 下載：FILE_REQ 附在 SYN 上，以先前連線取得的 cookie 直接開始傳送
+//   ./test_early_download [server 參數...]
+// 自行啟動 ./server，檢查三種情況都收到完整的檔案：
+//   1. 新連線沿用有效的 cookie：server 直接開始傳送
+//   2. 新連線帶錯誤的 cookie：server 拒絕 0-RTT，client 改走一般 FILE_REQ
+//   3. 已握手的連線帶錯誤的 cookie：同樣必須被拒絕
+// 並由 server 的輸出確認只有第 1 種被當成 0-RTT 接受。成功時 exit code 為 0。
+#include <arpa/inet.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.hpp"
+#include "client_connection.hpp"
+#include "event_loop.hpp"
+
+namespace
+{
+constexpr size_t kLines = 3000;
+const std::string kFilename = "test_early.txt";
+
+struct ServerLog {
+    size_t accepted = 0;
+    size_t rejected = 0;
+};
+
+// 讀完 server 的輸出，統計 0-RTT FILE_REQ 被接受與拒絕的次數
+ServerLog readLog(int fd)
+{
+    FILE *in = fdopen(fd, "r");
+    char line[4096];
+    ServerLog log;
+    while (std::fgets(line, sizeof(line), in)) {
+        if (std::strstr(line, "⚡ 0-RTT FILE_REQ"))
+            ++log.accepted;
+        else if (std::strstr(line, "0-RTT FILE_REQ 沒有有效 cookie"))
+            ++log.rejected;
+    }
+    std::fclose(in);
+    return log;
+}
+
+bool fetchEarly(EventLoop &loop,
+                ClientConnection &conn,
+                uint32_t cookie,
+                const std::vector<std::string> &expected,
+                const char *label)
+{
+    std::vector<std::string> received;
+    bool ok = loop.runUntilComplete(conn.downloadEarly(
+        cookie, kFilename,
+        [&received](std::string_view line) { received.emplace_back(line); }));
+    bool match = ok && received == expected;
+    std::printf("%s %s：%zu/%zu 行\n", match ? "✅" : "❌", label,
+                received.size(), expected.size());
+    return match;
+}
+
+Task<bool> sleepFor(EventLoop &loop, int ms)
+{
+    co_await loop.sleep(ms);
+    co_return true;
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> server_args(argv + 1, argv + argc);
+    std::vector<std::string> expected;
+    std::filesystem::create_directories("files");
+    {
+        std::ofstream out(std::filesystem::path("files") / kFilename);
+        for (size_t i = 0; i < kLines; ++i) {
+            expected.push_back("early line " + std::to_string(i));
+            out << expected.back() << "\n";
+        }
+    }
+
+    sockaddr_in server{};
+    server.sin_family = AF_INET;
+    server.sin_port = htons(9000);
+    server.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    waitForPort(server);
+    int out_fd = -1;
+    pid_t server_pid = startServer(server_args, &out_fd);
+    if (server_pid < 0) {
+        std::fprintf(stderr, "❌ 無法啟動 server\n");
+        return 1;
+    }
+    // server 的輸出必須持續讀取，否則 pipe 滿了 server 會卡住
+    ServerLog log;
+    std::thread reader([&] { log = readLog(out_fd); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    EventLoop loop;
+    ClientConnection first(loop, server);
+    bool connected = loop.runUntilComplete(first.connect());
+    bool passed = connected;
+    if (connected) {
+        uint32_t cookie = *first.cookie();
+        // 改動 MAC 的部分，slot 與 window 欄位不變
+        uint32_t forged = cookie ^ 0x5a5a5a;
+
+        ClientConnection fresh(loop, server);
+        passed &= fetchEarly(loop, fresh, cookie, expected, "沿用 cookie");
+        ClientConnection stranger(loop, server);
+        passed &= fetchEarly(loop, stranger, forged, expected, "錯誤 cookie");
+        passed &= fetchEarly(loop, first, forged, expected,
+                             "已握手的連線帶錯誤 cookie");
+        // 等 server 收到最後的 ACK
+        loop.runUntilComplete(sleepFor(loop, 200));
+    }
+
+    kill(server_pid, SIGTERM);
+    waitpid(server_pid, nullptr, 0);
+    reader.join();
+    std::filesystem::remove(std::filesystem::path("files") / kFilename);
+
+    if (!connected) {
+        std::fprintf(stderr, "❌ 無法連上 server\n");
+        return 1;
+    }
+    bool counted = log.accepted == 1 && log.rejected == 2;
+    std::printf("%s server 接受 %zu 次 0-RTT FILE_REQ、拒絕 %zu 次"
+                "（預期 1 / 2）\n",
+                counted ? "✅" : "❌", log.accepted, log.rejected);
+    return passed && counted ? 0 : 1;
+}
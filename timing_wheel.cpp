@@ -0,0 +1,67 @@
+#include "timing_wheel.hpp"
+
+#include <algorithm>
+
+TimingWheel::TimingWheel(std::chrono::milliseconds tick, size_t slots)
+    : origin_(Clock::now()), tick_(tick), slots_(slots)
+{
+}
+
+uint64_t TimingWheel::tickOf(Clock::time_point t) const
+{
+    if (t <= origin_)
+        return 0;
+    // 無條件進位：項目不會比排定時間早觸發
+    auto elapsed = t - origin_;
+    return (elapsed + tick_ - Clock::duration(1)) / tick_;
+}
+
+uint64_t TimingWheel::schedule(const std::string &key, Clock::time_point when)
+{
+    uint64_t tick = std::max(tickOf(when), current_);
+    slots_[tick % slots_.size()].emplace_back(key, tick);
+    ++size_;
+    return tick;
+}
+
+void TimingWheel::advance(
+    Clock::time_point now,
+    const std::function<void(const std::string &, uint64_t)> &cb)
+{
+    // 只處理已經完整經過的 tick
+    uint64_t target = (now - origin_) / tick_;
+    while (current_ <= target) {
+        std::vector<std::pair<std::string, uint64_t>> due;
+        std::vector<std::pair<std::string, uint64_t>> &slot =
+            slots_[current_ % slots_.size()];
+
+        // 先把到期的項目移出格子，cb 才能安全地再排入同一格。
+        // 整格到期時直接搬走它的記憶體，否則每一格都會留著尖峰時的容量，
+        // 轉過一圈後整個 wheel 佔用的記憶體就是尖峰流量的好幾百倍
+        auto later = std::partition(
+            slot.begin(), slot.end(),
+            [this](const auto &entry) { return entry.second > current_; });
+        if (later == slot.begin()) {
+            due.swap(slot);
+        } else {
+            due.assign(std::make_move_iterator(later),
+                       std::make_move_iterator(slot.end()));
+            slot.erase(later, slot.end());
+        }
+        size_ -= due.size();
+        ++current_;
+
+        for (const auto &[key, tick] : due)
+            cb(key, tick);
+    }
+}
+
+int TimingWheel::msUntilNextTick(Clock::time_point now) const
+{
+    auto next = origin_ + tick_ * current_;
+    if (next <= now)
+        return 0;
+    return std::chrono::duration_cast<std::chrono::milliseconds>(next - now)
+               .count() +
+           1;
+}
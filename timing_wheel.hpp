@@ -0,0 +1,41 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 粗粒度的 timing wheel：時間切成固定長度的 tick，每格存放在該 tick 到期的 key。
+// schedule() 與每個 tick 的處理都是 O(1)（攤銷），不需要定期掃描所有項目。
+// 只保證「不早於」排定時間觸發；超過一圈的項目在經過時留在原格等下一圈。
+class TimingWheel
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TimingWheel(std::chrono::milliseconds tick, size_t slots);
+
+    // 回傳排入的 tick 編號，呼叫端可據此辨識已被取代的舊項目
+    uint64_t schedule(const std::string &key, Clock::time_point when);
+
+    // 推進到 now，依序把每個到期的 (key, tick) 交給 cb；
+    // cb 中可以再呼叫 schedule()
+    void advance(Clock::time_point now,
+                 const std::function<void(const std::string &, uint64_t)> &cb);
+
+    // 距離下一個 tick 的毫秒數，供事件迴圈作為等待上限
+    int msUntilNextTick(Clock::time_point now) const;
+
+    size_t size() const { return size_; }
+
+private:
+    uint64_t tickOf(Clock::time_point t) const;
+
+    Clock::time_point origin_;
+    std::chrono::milliseconds tick_;
+    std::vector<std::vector<std::pair<std::string, uint64_t>>> slots_;
+    // 下一個尚未處理的 tick
+    uint64_t current_ = 0;
+    size_t size_ = 0;
+};
@@ -0,0 +1,273 @@
+#include "trace.hpp"
+
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string_view>
+#include <unordered_set>
+
+namespace
+{
+// 緩衝滿 2730 筆（約 64 KB）或每次 poll() 時寫入檔案
+constexpr size_t kFlushRecords = 65536 / sizeof(TraceRecord);
+constexpr std::chrono::seconds kPollInterval{1};
+
+// 追蹤所有連線時同時開啟的檔案上限，超過時關閉最久沒有事件的
+constexpr size_t kMaxOpenFiles = 512;
+
+// 整個字串都必須是 0 ~ 65535 的十進位數字
+bool parsePort(std::string_view text, uint16_t &port)
+{
+    const char *end = text.data() + text.size();
+    auto [ptr, ec] = std::from_chars(text.data(), end, port);
+    return ec == std::errc() && ptr == end;
+}
+} // namespace
+
+const char *to_string(TraceEvent ev)
+{
+    switch (ev) {
+    case TraceEvent::PacketSent:
+        return "packet_sent";
+    case TraceEvent::PacketReceived:
+        return "packet_received";
+    case TraceEvent::AckReceived:
+        return "ack_received";
+    case TraceEvent::PacketLost:
+        return "packet_lost";
+    case TraceEvent::Retransmit:
+        return "retransmit";
+    case TraceEvent::MetricsUpdated:
+        return "metrics_updated";
+    case TraceEvent::RttUpdated:
+        return "rtt_updated";
+    case TraceEvent::TimerFired:
+        return "timer_fired";
+    }
+    return "unknown";
+}
+
+const char *to_string(TraceTimer timer)
+{
+    switch (timer) {
+    case TraceTimer::Rto:
+        return "rto";
+    case TraceTimer::Persist:
+        return "persist";
+    case TraceTimer::Probe:
+        return "probe";
+    case TraceTimer::FileEnd:
+        return "file_end";
+    }
+    return "unknown";
+}
+
+Tracer::~Tracer()
+{
+    for (auto &[key, file] : files_)
+        flush(*file);
+}
+
+void Tracer::enable(const std::string &dir)
+{
+    dir_ = dir;
+    std::filesystem::create_directories(dir_);
+    std::cout << "🔍 事件追蹤：編輯 " << dir_
+              << "/enabled（每行 ip:port 或 *）即可開關\n";
+    // 第一次 poll() 就會讀取控制檔
+    next_poll_ = {};
+}
+
+uint64_t Tracer::keyOf(const sockaddr_in &peer)
+{
+    return (uint64_t(peer.sin_addr.s_addr) << 16) | peer.sin_port;
+}
+
+void Tracer::poll(Clock::time_point now)
+{
+    if (dir_.empty() || now < next_poll_)
+        return;
+    next_poll_ = now + kPollInterval;
+
+    std::error_code ec;
+    auto mtime = std::filesystem::last_write_time(dir_ + "/enabled", ec);
+    if (ec)
+        mtime = {};
+    if (mtime != control_mtime_) {
+        control_mtime_ = mtime;
+        reload();
+    }
+    for (auto &[key, file] : files_)
+        flush(*file);
+}
+
+// 依控制檔重建追蹤清單：不在清單中的檔案關閉，新加入的建立檔案
+void Tracer::reload()
+{
+    std::ifstream control(dir_ + "/enabled");
+    std::unordered_set<uint64_t> wanted;
+    bool all = false;
+    std::string line;
+    while (std::getline(control, line)) {
+        std::istringstream iss(line);
+        std::string entry;
+        if (!(iss >> entry) || entry[0] == '#')
+            continue;
+        if (entry == "*") {
+            all = true;
+            continue;
+        }
+
+        // 控制檔是手動編輯的，寫錯的行只略過，不能影響執行中的 server
+        sockaddr_in peer{};
+        size_t colon = entry.rfind(':');
+        uint16_t port = 0;
+        if (colon == std::string::npos ||
+            inet_pton(AF_INET, entry.substr(0, colon).c_str(),
+                      &peer.sin_addr) != 1 ||
+            !parsePort(entry.substr(colon + 1), port)) {
+            std::cerr << "⚠️ 無法解析追蹤目標：" << entry << "\n";
+            continue;
+        }
+        peer.sin_port = htons(port);
+        wanted.insert(keyOf(peer));
+    }
+
+    // 從沒有任何追蹤開始時重設時間原點；先前的檔案表頭不同，不會被接續
+    if (!active_ && (all || !wanted.empty())) {
+        origin_ = Clock::now();
+        origin_system_us_ =
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count();
+    }
+
+    for (auto it = files_.begin(); it != files_.end();) {
+        if (all || wanted.count(it->first)) {
+            ++it;
+            continue;
+        }
+        flush(*it->second);
+        std::cout << "🔍 停止追蹤 " << it->second->path << "\n";
+        it = files_.erase(it);
+    }
+    for (uint64_t key : wanted)
+        if (!files_.count(key))
+            open(key);
+
+    trace_all_ = all;
+    active_ = trace_all_ || !files_.empty();
+    if (trace_all_)
+        std::cout << "🔍 事件追蹤：所有連線\n";
+    else
+        std::cout << "🔍 事件追蹤：" << files_.size() << " 條連線\n";
+}
+
+Tracer::TraceFile *Tracer::open(uint64_t key, bool resume)
+{
+    sockaddr_in peer{};
+    peer.sin_addr.s_addr = uint32_t(key >> 16);
+    peer.sin_port = uint16_t(key);
+    char ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &peer.sin_addr, ip, sizeof(ip));
+    std::string path = dir_ + "/" + ip + "_" +
+                       std::to_string(ntohs(peer.sin_port)) + ".trace";
+
+    TraceFileHeader header{};
+    std::memcpy(header.magic, kTraceMagic, sizeof(header.magic));
+    header.version = kTraceVersion;
+    header.record_size = sizeof(TraceRecord);
+    header.reference_time_us = origin_system_us_;
+    header.peer_ip = peer.sin_addr.s_addr;
+    header.peer_port = ntohs(peer.sin_port);
+
+    // 表頭完全相同表示是這次追蹤先前關閉的檔案，record 的時間基準也相同
+    if (resume) {
+        TraceFileHeader existing{};
+        std::ifstream in(path, std::ios::binary);
+        in.read(reinterpret_cast<char *>(&existing), sizeof(existing));
+        resume = in && std::memcmp(&existing, &header, sizeof(header)) == 0;
+    }
+
+    if (trace_all_ && files_.size() >= kMaxOpenFiles)
+        closeOldest();
+
+    auto file = std::make_unique<TraceFile>();
+    file->path = path;
+    file->out.open(path, std::ios::binary |
+                             (resume ? std::ios::app : std::ios::trunc));
+    if (!file->out) {
+        std::cerr << "⚠️ 無法建立追蹤檔：" << path << "\n";
+        return nullptr;
+    }
+    if (!resume)
+        file->out.write(reinterpret_cast<const char *>(&header),
+                        sizeof(header));
+    file->buffer.reserve(kFlushRecords);
+
+    std::cout << (resume ? "🔍 繼續追蹤 " : "🔍 開始追蹤 ") << ip << ":"
+              << ntohs(peer.sin_port) << " → " << path << "\n";
+    return (files_[key] = std::move(file)).get();
+}
+
+void Tracer::close(const sockaddr_in &peer)
+{
+    if (!trace_all_)
+        return;
+    auto it = files_.find(keyOf(peer));
+    if (it == files_.end())
+        return;
+    flush(*it->second);
+    files_.erase(it);
+}
+
+// 只在追蹤所有連線且檔案數達到上限時呼叫，線性掃描的成本可以接受
+void Tracer::closeOldest()
+{
+    auto oldest = std::min_element(
+        files_.begin(), files_.end(), [](const auto &a, const auto &b) {
+            return a.second->last_us < b.second->last_us;
+        });
+    flush(*oldest->second);
+    files_.erase(oldest);
+}
+
+void Tracer::recordSlow(const sockaddr_in &peer,
+                        TraceEvent event,
+                        uint8_t packet_type,
+                        uint32_t seq,
+                        uint32_t a,
+                        uint32_t b)
+{
+    uint64_t key = keyOf(peer);
+    auto it = files_.find(key);
+    TraceFile *file = nullptr;
+    if (it != files_.end())
+        file = it->second.get();
+    else if (trace_all_ && (!filter_ || filter_(peer)))
+        file = open(key, true);
+    if (!file)
+        return;
+
+    uint64_t time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                           Clock::now() - origin_)
+                           .count();
+    file->last_us = time_us;
+    file->buffer.push_back({time_us, event, packet_type, 0, seq, a, b});
+    if (file->buffer.size() >= kFlushRecords)
+        flush(*file);
+}
+
+void Tracer::flush(TraceFile &file)
+{
+    if (file.buffer.empty())
+        return;
+    file.out.write(reinterpret_cast<const char *>(file.buffer.data()),
+                   file.buffer.size() * sizeof(TraceRecord));
+    file.out.flush();
+    file.buffer.clear();
+}
@@ -0,0 +1,137 @@
+#pragma once
+#include <netinet/in.h>
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 每條連線的二進位事件追蹤（供離線分析，trace_convert 可轉成 qlog 或 CSV）。
+//
+// server 以 --trace-dir=<dir> 啟動時，大約每秒重新讀取 <dir>/enabled：
+// 每行一個 "ip:port"，或以 "*" 追蹤所有連線。清單中的連線寫入
+// <dir>/<ip>_<port>.trace，從清單移除就關閉檔案；每次開始追蹤都會覆寫舊檔。
+// 追蹤所有連線時，連線被淘汰或開啟的檔案太多就先關閉，之後再有事件時
+// 接續寫在同一個檔案後面。沒有任何連線在追蹤時，record() 只是一次 bool 判斷。
+
+enum class TraceEvent : uint8_t {
+    PacketSent,      // seq、type，a = bytes
+    PacketReceived,  // seq、type，a = bytes
+    AckReceived,     // seq = 被確認的資料 seq，a = 通告視窗，b = 本輪未確認數
+    PacketLost,      // seq
+    Retransmit,      // seq
+    MetricsUpdated,  // a = cwnd，b = ssthresh，seq = 在途封包數
+    RttUpdated,      // a = 最新 RTT（µs），b = 平滑後的 RTT（µs）
+    TimerFired,      // a = TraceTimer，seq = 當時的下一個 chunk
+};
+
+enum class TraceTimer : uint8_t { Rto, Persist, Probe, FileEnd };
+
+const char *to_string(TraceEvent ev);
+const char *to_string(TraceTimer timer);
+
+// 檔頭之後是連續的 TraceRecord，皆為主機位元組序
+struct TraceFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    // server 開始追蹤時的 system_clock（µs），record 的時間都相對於它
+    uint64_t reference_time_us;
+    uint32_t peer_ip;  // network byte order
+    uint16_t peer_port;
+    uint16_t reserved;
+};
+
+struct TraceRecord {
+    uint64_t time_us;
+    TraceEvent event;
+    uint8_t packet_type;
+    uint16_t reserved;
+    uint32_t seq;
+    uint32_t a;
+    uint32_t b;
+};
+
+static_assert(sizeof(TraceFileHeader) == 32);
+static_assert(sizeof(TraceRecord) == 24);
+
+constexpr char kTraceMagic[8] = {'S', 'T', 'O', 'U', 'T', 'R', 'C', '\0'};
+constexpr uint32_t kTraceVersion = 1;
+
+class Tracer
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Tracer() = default;
+    ~Tracer();
+    Tracer(const Tracer &) = delete;
+    Tracer &operator=(const Tracer &) = delete;
+
+    // 指定追蹤目錄後才會讀取控制檔；不呼叫則永遠不追蹤
+    void enable(const std::string &dir);
+    // 控制檔變更時更新追蹤清單，並把緩衝中的事件寫入檔案
+    void poll(Clock::time_point now);
+
+    bool active() const { return active_; }
+
+    // 追蹤所有連線時只為 filter 接受的 peer 建立檔案，偽造來源位址的封包
+    // 不會讓 server 替它開檔；控制檔明確列出的連線不受影響
+    void setFilter(std::function<bool(const sockaddr_in &)> filter)
+    {
+        filter_ = std::move(filter);
+    }
+
+    // 連線被 ConnectionTable 淘汰時呼叫；只有追蹤所有連線時才關閉檔案，
+    // 控制檔明確列出的連線可能重新連上，檔案保持開啟
+    void close(const sockaddr_in &peer);
+
+    void record(const sockaddr_in &peer,
+                TraceEvent event,
+                uint8_t packet_type,
+                uint32_t seq,
+                uint32_t a = 0,
+                uint32_t b = 0)
+    {
+        if (active_)
+            recordSlow(peer, event, packet_type, seq, a, b);
+    }
+
+private:
+    struct TraceFile {
+        std::string path;
+        std::ofstream out;
+        std::vector<TraceRecord> buffer;
+        // 最後一個事件的時間，檔案太多時先關閉最久沒有事件的
+        uint64_t last_us = 0;
+    };
+
+    static uint64_t keyOf(const sockaddr_in &peer);
+    void recordSlow(const sockaddr_in &peer,
+                    TraceEvent event,
+                    uint8_t packet_type,
+                    uint32_t seq,
+                    uint32_t a,
+                    uint32_t b);
+    // resume 時若檔案是本次追蹤先前關閉的，接續寫在後面而不覆寫
+    TraceFile *open(uint64_t key, bool resume = false);
+    void closeOldest();
+    void reload();
+    static void flush(TraceFile &file);
+
+    std::string dir_;
+    bool active_ = false;
+    // 控制檔為 "*" 時，連線在第一個事件發生時才建立檔案
+    bool trace_all_ = false;
+    std::function<bool(const sockaddr_in &)> filter_;
+    std::unordered_map<uint64_t, std::unique_ptr<TraceFile>> files_;
+    std::filesystem::file_time_type control_mtime_{};
+    Clock::time_point next_poll_{};
+    Clock::time_point origin_ = Clock::now();
+    uint64_t origin_system_us_ = 0;
+};
@@ -0,0 +1,173 @@
+// 把 server 的二進位事件追蹤檔轉成 qlog（JSON）或 CSV，輸出到 stdout
+//   ./trace_convert <file.trace> [--format=qlog|csv]
+// CSV 每列一個事件，cwnd、ssthresh、in_flight 等欄位只在相關事件填入，
+// 可直接以試算表或 gnuplot 畫出 cwnd 與在途封包數隨時間的變化。
+#include <arpa/inet.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "packet.hpp"
+#include "trace.hpp"
+
+namespace
+{
+std::string packetTypeName(uint8_t type)
+{
+    if (type > static_cast<uint8_t>(PacketType::RST))
+        return "UNKNOWN";
+    return to_string(static_cast<PacketType>(type));
+}
+
+double ms(uint64_t us)
+{
+    return us / 1000.0;
+}
+
+void writeCsv(const std::vector<TraceRecord> &records)
+{
+    std::printf("time_ms,event,packet_type,seq,bytes,peer_window,cwnd,"
+                "ssthresh,in_flight,rtt_ms,srtt_ms,timer\n");
+    for (const TraceRecord &r : records) {
+        std::printf("%.3f,%s,", ms(r.time_us), to_string(r.event));
+        switch (r.event) {
+        case TraceEvent::PacketSent:
+        case TraceEvent::PacketReceived:
+            std::printf("%s,%u,%u,,,,,,,\n",
+                        packetTypeName(r.packet_type).c_str(), r.seq, r.a);
+            break;
+        case TraceEvent::AckReceived:
+            std::printf("%s,%u,,%u,,,%u,,,\n",
+                        packetTypeName(r.packet_type).c_str(), r.seq, r.a,
+                        r.b);
+            break;
+        case TraceEvent::PacketLost:
+        case TraceEvent::Retransmit:
+            std::printf("%s,%u,,,,,,,,\n",
+                        packetTypeName(r.packet_type).c_str(), r.seq);
+            break;
+        case TraceEvent::MetricsUpdated:
+            std::printf(",,,,%u,%u,%u,,,\n", r.a, r.b, r.seq);
+            break;
+        case TraceEvent::RttUpdated:
+            std::printf(",%u,,,,,,%.3f,%.3f,\n", r.seq, ms(r.a), ms(r.b));
+            break;
+        case TraceEvent::TimerFired:
+            std::printf(",%u,,,,,,,,%s\n", r.seq,
+                        to_string(static_cast<TraceTimer>(r.a)));
+            break;
+        }
+    }
+}
+
+// qlog 0.3 的 JSON 格式；沒有對應定義的事件以 "stou:" 前綴命名
+void writeQlog(const TraceFileHeader &header,
+               const std::vector<TraceRecord> &records)
+{
+    char ip[INET_ADDRSTRLEN];
+    in_addr addr{header.peer_ip};
+    inet_ntop(AF_INET, &addr, ip, sizeof(ip));
+
+    std::printf("{\"qlog_version\":\"0.3\",\"qlog_format\":\"JSON\","
+                "\"title\":\"simple-tcp-over-udp\",\"traces\":[{"
+                "\"title\":\"%s:%u\",\"vantage_point\":{\"type\":\"server\"},"
+                "\"common_fields\":{\"time_format\":\"relative\","
+                "\"reference_time\":%.3f},\"events\":[",
+                ip, header.peer_port, ms(header.reference_time_us));
+
+    const char *sep = "\n";
+    for (const TraceRecord &r : records) {
+        std::printf("%s{\"time\":%.3f,", sep, ms(r.time_us));
+        sep = ",\n";
+        std::string type = packetTypeName(r.packet_type);
+        switch (r.event) {
+        case TraceEvent::PacketSent:
+        case TraceEvent::PacketReceived:
+            std::printf("\"name\":\"transport:%s\",\"data\":{\"header\":{"
+                        "\"packet_type\":\"%s\",\"packet_number\":%u},"
+                        "\"raw\":{\"length\":%u}}}",
+                        to_string(r.event), type.c_str(), r.seq, r.a);
+            break;
+        case TraceEvent::AckReceived:
+            std::printf("\"name\":\"stou:ack_received\",\"data\":{"
+                        "\"acked\":%u,\"peer_window\":%u,"
+                        "\"packets_in_flight\":%u}}",
+                        r.seq, r.a, r.b);
+            break;
+        case TraceEvent::PacketLost:
+            std::printf("\"name\":\"recovery:packet_lost\",\"data\":{"
+                        "\"header\":{\"packet_type\":\"%s\","
+                        "\"packet_number\":%u}}}",
+                        type.c_str(), r.seq);
+            break;
+        case TraceEvent::Retransmit:
+            std::printf("\"name\":\"stou:packet_retransmitted\",\"data\":{"
+                        "\"header\":{\"packet_type\":\"%s\","
+                        "\"packet_number\":%u}}}",
+                        type.c_str(), r.seq);
+            break;
+        case TraceEvent::MetricsUpdated:
+            std::printf("\"name\":\"recovery:metrics_updated\",\"data\":{"
+                        "\"congestion_window\":%u,\"ssthresh\":%u,"
+                        "\"packets_in_flight\":%u}}",
+                        r.a, r.b, r.seq);
+            break;
+        case TraceEvent::RttUpdated:
+            std::printf("\"name\":\"recovery:metrics_updated\",\"data\":{"
+                        "\"latest_rtt\":%.3f,\"smoothed_rtt\":%.3f}}",
+                        ms(r.a), ms(r.b));
+            break;
+        case TraceEvent::TimerFired:
+            std::printf("\"name\":\"recovery:loss_timer_updated\",\"data\":{"
+                        "\"event_type\":\"expired\",\"timer_type\":\"%s\"}}",
+                        to_string(static_cast<TraceTimer>(r.a)));
+            break;
+        }
+    }
+    std::printf("\n]}]}\n");
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        std::cerr << "用法：" << argv[0]
+                  << " <file.trace> [--format=qlog|csv]\n";
+        return 1;
+    }
+    std::string format = "qlog";
+    for (int i = 2; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--format=", 0) == 0)
+            format = arg.substr(9);
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    TraceFileHeader header{};
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, kTraceMagic, sizeof(header.magic)) != 0) {
+        std::cerr << "❌ 不是追蹤檔：" << argv[1] << "\n";
+        return 1;
+    }
+    if (header.version != kTraceVersion ||
+        header.record_size != sizeof(TraceRecord)) {
+        std::cerr << "❌ 不支援的追蹤檔版本 " << header.version << "\n";
+        return 1;
+    }
+
+    // server 寫到一半被中止時，最後一筆可能不完整，直接忽略
+    std::vector<TraceRecord> records;
+    TraceRecord r;
+    while (in.read(reinterpret_cast<char *>(&r), sizeof(r)))
+        records.push_back(r);
+
+    if (format == "csv")
+        writeCsv(records);
+    else
+        writeQlog(header, records);
+    return 0;
+}